@@ -1,60 +1,873 @@
 #include "DemMaker.h"
+#include "DemPyramid.h"
+#include "../Utils/CpuFeatures.h"
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
+#include <bitset>
+#include <type_traits>
+#include <limits>
+#include <mutex>
 
-std::vector<Point> getNormalizePoints(const std::vector<float>& elevations, int step)
+// ---- min/max ---------------------------------------------------------------
+
+// Void-aware min/max of 'n' samples. Returns false if every sample is void.
+template <typename T>
+static bool elevationRangeScalar(const T* data, size_t n, float& minElevation, float& maxElevation)
+{
+    const T voidValue = static_cast<T>(kHgtVoid);
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] == voidValue) continue;
+        const float f = static_cast<float>(data[i]);
+        lo = std::min(lo, f);
+        hi = std::max(hi, f);
+    }
+    minElevation = lo;
+    maxElevation = hi;
+    return lo <= hi;
+}
+
+#if SIM_X86
+// Voids are replaced by +max for the min and (already being the lowest value)
+// left alone for the max, so both reductions run without branches.
+SIM_TARGET_AVX2 static bool elevationRangeAvx2(const float* data, size_t n, float& minElevation, float& maxElevation)
+{
+    const __m256 voidValue = _mm256_set1_ps(static_cast<float>(kHgtVoid));
+    const __m256 highest = _mm256_set1_ps(std::numeric_limits<float>::max());
+    __m256 vmin = highest;
+    __m256 vmax = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(data + i);
+        const __m256 isVoid = _mm256_cmp_ps(v, voidValue, _CMP_EQ_OQ);
+        vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(v, highest, isVoid));
+        vmax = _mm256_max_ps(vmax, _mm256_blendv_ps(v, _mm256_set1_ps(std::numeric_limits<float>::lowest()), isVoid));
+    }
+
+    alignas(32) float mins[8], maxs[8];
+    _mm256_store_ps(mins, vmin);
+    _mm256_store_ps(maxs, vmax);
+    float tailMin, tailMax;
+    elevationRangeScalar(data + i, n - i, tailMin, tailMax);
+    minElevation = std::min(tailMin, *std::min_element(mins, mins + 8));
+    maxElevation = std::max(tailMax, *std::max_element(maxs, maxs + 8));
+    return minElevation <= maxElevation;
+}
+
+SIM_TARGET_AVX2 static bool elevationRangeAvx2(const int16_t* data, size_t n, float& minElevation, float& maxElevation)
+{
+    const __m256i voidValue = _mm256_set1_epi16(kHgtVoid);
+    const __m256i highest = _mm256_set1_epi16(32767);
+    __m256i vmin = highest;
+    __m256i vmax = voidValue;
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        vmin = _mm256_min_epi16(vmin, _mm256_blendv_epi8(v, highest, _mm256_cmpeq_epi16(v, voidValue)));
+        vmax = _mm256_max_epi16(vmax, v);
+    }
+
+    alignas(32) int16_t mins[16], maxs[16];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(mins), vmin);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(maxs), vmax);
+    const int16_t lo = *std::min_element(mins, mins + 16);
+    const int16_t hi = *std::max_element(maxs, maxs + 16);
+
+    float tailMin, tailMax;
+    elevationRangeScalar(data + i, n - i, tailMin, tailMax);
+    // An all-void vector part leaves hi at the void value; the tail decides then.
+    minElevation = std::min(tailMin, hi == kHgtVoid ? tailMin : static_cast<float>(lo));
+    maxElevation = std::max(tailMax, hi == kHgtVoid ? tailMax : static_cast<float>(hi));
+    return minElevation <= maxElevation;
+}
+#endif
+
+template <typename T>
+static bool elevationRange(const T* data, size_t n, float& minElevation, float& maxElevation)
+{
+#if SIM_X86
+    if (cpuHasAvx2()) return elevationRangeAvx2(data, n, minElevation, maxElevation);
+#endif
+    return elevationRangeScalar(data, n, minElevation, maxElevation);
+}
+
+// ---- normalization -----------------------------------------------------------
+
+// z = (max(e, min) - min) * scale + bias for one sample, capped at 1 since the
+// reciprocal scale can overshoot the top by an ulp. Clamping to the minimum
+// puts voids on the lowest plane without a branch.
+template <typename T>
+static float normalizeHeight(T e, float minElevation, float scale, float bias)
+{
+    return std::min((std::max(static_cast<float>(e), minElevation) - minElevation) * scale + bias, 1.0f);
+}
+
+template <typename T>
+static void normalizeHeightsScalar(const T* src, float* dst, size_t n, float minElevation, float scale, float bias)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = normalizeHeight(src[i], minElevation, scale, bias);
+    }
+}
+
+#if SIM_X86
+SIM_TARGET_AVX2 static void normalizeHeightsAvx2(const float* src, float* dst, size_t n, float minElevation, float scale, float bias)
+{
+    const __m256 vmin = _mm256_set1_ps(minElevation);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vbias = _mm256_set1_ps(bias);
+    const __m256 vone = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 h = _mm256_sub_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), vmin), vmin);
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(h, vscale), vbias), vone));
+    }
+    normalizeHeightsScalar(src + i, dst + i, n - i, minElevation, scale, bias);
+}
+
+SIM_TARGET_AVX2 static void normalizeHeightsAvx2(const int16_t* src, float* dst, size_t n, float minElevation, float scale, float bias)
+{
+    const __m256 vmin = _mm256_set1_ps(minElevation);
+    const __m256 vscale = _mm256_set1_ps(scale);
+    const __m256 vbias = _mm256_set1_ps(bias);
+    const __m256 vone = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m256 e = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw));
+        const __m256 h = _mm256_sub_ps(_mm256_max_ps(e, vmin), vmin);
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(h, vscale), vbias), vone));
+    }
+    normalizeHeightsScalar(src + i, dst + i, n - i, minElevation, scale, bias);
+}
+#endif
+
+template <typename T>
+static void normalizeHeights(const T* src, float* dst, size_t n, float minElevation, float scale, float bias)
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        normalizeHeightsAvx2(src, dst, n, minElevation, scale, bias);
+        return;
+    }
+#endif
+    normalizeHeightsScalar(src, dst, n, minElevation, scale, bias);
+}
+
+// ---- grid traversal ----------------------------------------------------------
+
+// Row 'r' of a view as directly usable samples. Big-endian HgtSample rows are
+// byte-swapped into 'scratch' (one row, not the whole grid) first.
+template <typename T>
+static const T* loadRow(const GridView<T>& grid, size_t r, std::vector<int16_t>&)
+{
+    return grid.row(r);
+}
+
+static const int16_t* loadRow(const GridView<HgtSample>& grid, size_t r, std::vector<int16_t>& scratch)
+{
+    scratch.resize(grid.cols);
+    decodeHgtSamples(reinterpret_cast<const uint8_t*>(grid.row(r)), scratch.data(), grid.cols);
+    return scratch.data();
+}
+
+// Void-aware range of the whole view, in row bands on 'pool' if given.
+// Min/max are exact, so the result does not depend on the split.
+template <typename T>
+static bool elevationRange(const GridView<T>& grid, float& minElevation, float& maxElevation, ThreadPool* pool)
+{
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    std::mutex mutex;
+    forBands(pool, grid.rows, [&](size_t r0, size_t r1) {
+        float bandMin = std::numeric_limits<float>::max();
+        float bandMax = std::numeric_limits<float>::lowest();
+        std::vector<int16_t> scratch;
+        for (size_t r = r0; r < r1; r++) {
+            float rowMin, rowMax;
+            if (!elevationRange(loadRow(grid, r, scratch), grid.cols, rowMin, rowMax)) continue;
+            bandMin = std::min(bandMin, rowMin);
+            bandMax = std::max(bandMax, rowMax);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        lo = std::min(lo, bandMin);
+        hi = std::max(hi, bandMax);
+    });
+    minElevation = lo;
+    maxElevation = hi;
+    return lo <= hi;
+}
+
+// Everything needed to normalize a grid, fixed before the emit loop.
+// Both axes share one scale set by the longer side, so windows keep their
+// aspect ratio; the longer axis spans [-1,1] and the shorter one is centred.
+struct GridNormalization {
+    size_t step = 1;     // sampling step within the grid that is read
+    size_t spacing = 1;  // base grid cells between output samples; step, unless reading a pyramid level
+    size_t outRows = 0;  // sampled rows
+    size_t outCols = 0;  // sampled columns
+    float invOffset = 1.0f;
+    float xBias = 1.0f;
+    float yBias = 1.0f;
+    float minElevation = 0.0f;
+    float zScale = 0.0f;
+    float zBias = 0.0f;
+};
+
+static GridNormalization makeNormalization(size_t rows, size_t cols, float minElevation, float maxElevation, int step)
 {
     if (step <= 0) throw std::invalid_argument("step must be >= 1");
-    if (elevations.empty()) return {};
 
-    // Ensure input represents a square grid
-    const size_t n = elevations.size();
-    const double root = std::sqrt(static_cast<double>(n));
-    const size_t size = static_cast<size_t>(std::lround(root));
-    if (size * size != n) {
-        throw std::invalid_argument("elevations.size() must be a perfect square");
+    GridNormalization g;
+    g.step = static_cast<size_t>(step);
+    g.spacing = g.step;
+    g.outRows = (rows + g.step - 1) / g.step;
+    g.outCols = (cols + g.step - 1) / g.step;
+
+    // Offset maps grid coords to [-1,1]: p = c / offset - bias.
+    const size_t longest = std::max(rows, cols);
+    const float offset = (longest > 1) ? static_cast<float>(longest - 1) / 2.0f : 1.0f;
+    g.invOffset = 1.0f / offset;
+    if (longest > 1) {
+        g.xBias = static_cast<float>(cols - 1) / static_cast<float>(longest - 1);
+        g.yBias = static_cast<float>(rows - 1) / static_cast<float>(longest - 1);
     }
 
-    // Find min/max elevation
-    auto minIt = std::min_element(elevations.begin(), elevations.end());
-    auto maxIt = std::max_element(elevations.begin(), elevations.end());
-    const float minElevation = *minIt;
-    const float maxElevation = *maxIt;
+    // z = (e - min) * 2/range - 1; a constant grid collapses to the centre plane.
     const float elevationRange = maxElevation - minElevation;
+    g.minElevation = minElevation;
+    g.zScale = elevationRange > 0.0f ? 2.0f / elevationRange : 0.0f;
+    g.zBias = elevationRange > 0.0f ? -1.0f : 0.0f;
+    return g;
+}
 
-    // Offset maps grid coords to [-1,1].
-    const float offset = (size > 1) ? static_cast<float>(size - 1) / 2.0f : 1.0f;
-
-    // Estimate number of samples to reserve (avoid many reallocations)
-    const size_t stepU = static_cast<size_t>(std::max(1, step));
-    const size_t samplesX = (size + stepU - 1) / stepU;
-    const size_t samplesY = (size + stepU - 1) / stepU;
-    std::vector<Point> result;
-    result.reserve(samplesX * samplesY);
-
-    for (size_t y = 0; y < size; y += stepU) {
-        for (size_t x = 0; x < size; x += stepU) {
-            const size_t idx = y * size + x;
-            const float elev = elevations[idx];
-
-            // Normalize X/Y to [-1,1]
-            const float px = (offset == 0.0f) ? 0.0f : (static_cast<float>(x) - offset) / offset;
-            const float py = (offset == 0.0f) ? 0.0f : (static_cast<float>(y) - offset) / offset;
-
-            // Normalize elevation to -1..1. Handle constant elevation (avoid div-by-zero).
-            float pz;
-            if (elevationRange == 0.0f) {
-                pz = 0.0f; // all elevations are equal -> center plane
-            } else {
-                const float h = (elev - minElevation) / elevationRange; // 0..1
-                pz = h * 2.0f - 1.0f; // -1..1
-            }
+// Range from a void-aware scan of the samples.
+template <typename T>
+static GridNormalization prepareNormalization(const GridView<T>& grid, int step, ThreadPool* pool)
+{
+    // An all-void grid collapses to the centre plane.
+    float minElevation, maxElevation;
+    if (!elevationRange(grid, minElevation, maxElevation, pool)) {
+        minElevation = maxElevation = 0.0f;
+    }
+    return makeNormalization(grid.rows, grid.cols, minElevation, maxElevation, step);
+}
 
-            result.emplace_back(px, py, pz);
+// Range from statistics gathered while decoding.
+template <typename T>
+static GridNormalization prepareNormalization(const GridView<T>& grid, const HgtStats& stats, int step)
+{
+    // An all-void grid (min > max) collapses to the centre plane.
+    const float minElevation = stats.validCount ? static_cast<float>(stats.minValue) : 0.0f;
+    const float maxElevation = stats.validCount ? static_cast<float>(stats.maxValue) : 0.0f;
+    return makeNormalization(grid.rows, grid.cols, minElevation, maxElevation, step);
+}
+
+static float normalizedCoord(size_t c, float invOffset, float bias)
+{
+    return static_cast<float>(c) * invOffset - bias;
+}
+
+// Normalized heights of the sampled cells of grid row 'y' into 'zs' (g.outCols values).
+template <typename T>
+static void normalizeRow(const GridView<T>& grid, const GridNormalization& g, size_t y, float* zs, std::vector<int16_t>& scratch)
+{
+    const auto* row = loadRow(grid, y, scratch);
+    if (g.step == 1) {
+        normalizeHeights(row, zs, grid.cols, g.minElevation, g.zScale, g.zBias);
+    } else {
+        for (size_t i = 0; i < g.outCols; i++) {
+            zs[i] = normalizeHeight(row[i * g.step], g.minElevation, g.zScale, g.zBias);
         }
     }
+}
+
+// Each emitter writes output row r straight into its final slot, so bands of
+// rows can be produced by different threads.
+template <typename T>
+static std::vector<Point> emitPoints(const GridView<T>& grid, const GridNormalization& g, ThreadPool* pool)
+{
+    // X only depends on the column; compute it once for all rows.
+    std::vector<float> xs(g.outCols);
+    for (size_t i = 0; i < g.outCols; i++) {
+        xs[i] = normalizedCoord(i * g.spacing, g.invOffset, g.xBias);
+    }
+
+    std::vector<Point> result(g.outRows * g.outCols);
+    forBands(pool, g.outRows, [&](size_t r0, size_t r1) {
+        std::vector<float> zs(g.outCols);
+        std::vector<int16_t> scratch;
+        for (size_t r = r0; r < r1; r++) {
+            const float py = normalizedCoord(r * g.spacing, g.invOffset, g.yBias);
+            normalizeRow(grid, g, r * g.step, zs.data(), scratch);
+            Point* out = result.data() + r * g.outCols;
+            for (size_t i = 0; i < g.outCols; i++) {
+                out[i] = Point(xs[i], py, zs[i]);
+            }
+        }
+    });
+    return result;
+}
+
+template <typename T>
+static PointsSoA emitPointsSoA(const GridView<T>& grid, const GridNormalization& g, ThreadPool* pool)
+{
+    const size_t n = g.outRows * g.outCols;
+    PointsSoA result;
+    result.x.resize(n);
+    result.y.resize(n);
+    result.z.resize(n);
+
+    for (size_t i = 0; i < g.outCols && n > 0; i++) {
+        result.x[i] = normalizedCoord(i * g.spacing, g.invOffset, g.xBias);
+    }
+    forBands(pool, g.outRows, [&](size_t r0, size_t r1) {
+        std::vector<int16_t> scratch;
+        for (size_t r = std::max<size_t>(r0, 1); r < r1; r++) {
+            std::copy(result.x.begin(), result.x.begin() + g.outCols, result.x.begin() + r * g.outCols);
+        }
+        for (size_t r = r0; r < r1; r++) {
+            const size_t first = r * g.outCols;
+            std::fill(result.y.begin() + first, result.y.begin() + first + g.outCols, normalizedCoord(r * g.spacing, g.invOffset, g.yBias));
+            normalizeRow(grid, g, r * g.step, result.z.data() + first, scratch);
+        }
+    });
+    return result;
+}
 
+template <typename T>
+static HeightGrid emitHeights(const GridView<T>& grid, const GridNormalization& g, ThreadPool* pool)
+{
+    HeightGrid result;
+    result.rows = g.outRows;
+    result.cols = g.outCols;
+    result.step = g.spacing;
+    result.invOffset = g.invOffset;
+    result.xBias = g.xBias;
+    result.yBias = g.yBias;
+    result.z.resize(g.outRows * g.outCols);
+    forBands(pool, g.outRows, [&](size_t r0, size_t r1) {
+        std::vector<int16_t> scratch;
+        for (size_t r = r0; r < r1; r++) {
+            normalizeRow(grid, g, r * g.step, result.z.data() + r * g.outCols, scratch);
+        }
+    });
     return result;
-}
\ No newline at end of file
+}
+
+template <typename T>
+std::vector<Point> getNormalizePoints(const GridView<T>& grid, int step, ThreadPool* pool)
+{
+    return emitPoints(grid, prepareNormalization(grid, step, pool), pool);
+}
+
+template <typename T>
+std::vector<Point> getNormalizePoints(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return emitPoints(grid, prepareNormalization(grid, stats, step), pool);
+}
+
+template <typename T>
+PointsSoA getNormalizePointsSoA(const GridView<T>& grid, int step, ThreadPool* pool)
+{
+    return emitPointsSoA(grid, prepareNormalization(grid, step, pool), pool);
+}
+
+template <typename T>
+PointsSoA getNormalizePointsSoA(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return emitPointsSoA(grid, prepareNormalization(grid, stats, step), pool);
+}
+
+template <typename T>
+HeightGrid getNormalizedHeights(const GridView<T>& grid, int step, ThreadPool* pool)
+{
+    return emitHeights(grid, prepareNormalization(grid, step, pool), pool);
+}
+
+template <typename T>
+HeightGrid getNormalizedHeights(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return emitHeights(grid, prepareNormalization(grid, stats, step), pool);
+}
+
+// The square-vector overloads are views over the whole vector.
+
+template <typename T>
+std::vector<Point> getNormalizePoints(const std::vector<T>& elevations, int step, ThreadPool* pool)
+{
+    return getNormalizePoints(GridView<T>::square(elevations), step, pool);
+}
+
+template <typename T>
+std::vector<Point> getNormalizePoints(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return getNormalizePoints(GridView<T>::square(elevations), stats, step, pool);
+}
+
+template <typename T>
+PointsSoA getNormalizePointsSoA(const std::vector<T>& elevations, int step, ThreadPool* pool)
+{
+    return getNormalizePointsSoA(GridView<T>::square(elevations), step, pool);
+}
+
+template <typename T>
+PointsSoA getNormalizePointsSoA(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return getNormalizePointsSoA(GridView<T>::square(elevations), stats, step, pool);
+}
+
+template <typename T>
+HeightGrid getNormalizedHeights(const std::vector<T>& elevations, int step, ThreadPool* pool)
+{
+    return getNormalizedHeights(GridView<T>::square(elevations), step, pool);
+}
+
+template <typename T>
+HeightGrid getNormalizedHeights(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool)
+{
+    return getNormalizedHeights(GridView<T>::square(elevations), stats, step, pool);
+}
+
+// A pyramid level is read in full (step 1) and placed at the positions of
+// step 2^level in the base grid, normalized with the base range.
+static GridNormalization prepareNormalization(const DemPyramid& pyramid, size_t level)
+{
+    if (level >= pyramid.levelCount()) throw std::out_of_range("pyramid level out of range");
+    float minElevation, maxElevation;
+    if (!pyramid.elevationRange(minElevation, maxElevation)) {
+        minElevation = maxElevation = 0.0f;
+    }
+    GridNormalization g = makeNormalization(pyramid.rows(), pyramid.cols(), minElevation, maxElevation, 1);
+    g.spacing = pyramid.level(level).scale;
+    g.outRows = pyramid.level(level).rows;
+    g.outCols = pyramid.level(level).cols;
+    return g;
+}
+
+std::vector<Point> getNormalizePoints(const DemPyramid& pyramid, size_t level, ThreadPool* pool)
+{
+    return emitPoints(pyramid.level(level).meanView(), prepareNormalization(pyramid, level), pool);
+}
+
+HeightGrid getNormalizedHeights(const DemPyramid& pyramid, size_t level, ThreadPool* pool)
+{
+    return emitHeights(pyramid.level(level).meanView(), prepareNormalization(pyramid, level), pool);
+}
+
+// ---- adaptive simplification ------------------------------------------------
+
+// Quadtree block between two corner samples (inclusive); at least one cell.
+struct QuadBlock {
+    uint32_t r0, c0, r1, c1;
+    float error; // max vertical error once accepted
+};
+
+// Row-major order of the top-left corners.
+static bool quadBlockBefore(const QuadBlock& a, const QuadBlock& b)
+{
+    return a.r0 != b.r0 ? a.r0 < b.r0 : a.c0 < b.c0;
+}
+
+template <typename T>
+struct SimplifyContext {
+    const GridView<T>& grid;
+    float floor;     // voids and anything below are clamped to the minimum
+    float tolerance;
+
+    float elevation(size_t r, size_t c) const { return std::max(sampleValue(grid.at(r, c)), floor); }
+};
+
+// Max error of the block against its two triangles (A,B,D) and (A,D,C), where
+// A..D are the top-left, top-right, bottom-left and bottom-right corners.
+// Stops scanning as soon as the tolerance is exceeded.
+template <typename T>
+static float blockError(const SimplifyContext<T>& ctx, const QuadBlock& b)
+{
+    const float zA = ctx.elevation(b.r0, b.c0), zB = ctx.elevation(b.r0, b.c1);
+    const float zC = ctx.elevation(b.r1, b.c0), zD = ctx.elevation(b.r1, b.c1);
+    const int64_t w = b.c1 - b.c0, h = b.r1 - b.r0;
+    const float invW = 1.0f / static_cast<float>(w), invH = 1.0f / static_cast<float>(h);
+
+    float maxError = 0.0f;
+    for (int64_t dr = 0; dr <= h; dr++) {
+        const float v = static_cast<float>(dr) * invH;
+        for (int64_t dc = 0; dc <= w; dc++) {
+            const float u = static_cast<float>(dc) * invW;
+            // Upper triangle (A,B,D) where u >= v, tested exactly in integers.
+            const float z = (dc * h >= dr * w) ? zA + u * (zB - zA) + v * (zD - zB)
+                                               : zA + v * (zC - zA) + u * (zD - zC);
+            maxError = std::max(maxError, std::fabs(ctx.elevation(b.r0 + dr, b.c0 + dc) - z));
+        }
+        if (maxError > ctx.tolerance) break;
+    }
+    return maxError;
+}
+
+// Max error of the samples inside one triangle of grid vertices (flat indices).
+template <typename T>
+static float triangleError(const SimplifyContext<T>& ctx, const uint32_t (&v)[3])
+{
+    const int64_t cols = static_cast<int64_t>(ctx.grid.cols);
+    int64_t x[3], y[3];
+    float z[3];
+    for (int i = 0; i < 3; i++) {
+        y[i] = v[i] / cols;
+        x[i] = v[i] % cols;
+        z[i] = ctx.elevation(static_cast<size_t>(y[i]), static_cast<size_t>(x[i]));
+    }
+    const int64_t det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (det == 0) return 0.0f;
+    const float invDet = 1.0f / static_cast<float>(det);
+
+    float maxError = 0.0f;
+    for (int64_t r = std::min({ y[0], y[1], y[2] }); r <= std::max({ y[0], y[1], y[2] }); r++) {
+        for (int64_t c = std::min({ x[0], x[1], x[2] }); c <= std::max({ x[0], x[1], x[2] }); c++) {
+            // Barycentric numerators; inside (or on an edge) when both and
+            // their sum lie between 0 and det.
+            const int64_t a = (c - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (r - y[0]);
+            const int64_t b = (x[1] - x[0]) * (r - y[0]) - (c - x[0]) * (y[1] - y[0]);
+            const bool inside = det > 0 ? (a >= 0 && b >= 0 && a + b <= det) : (a <= 0 && b <= 0 && a + b >= det);
+            if (!inside) continue;
+            const float zi = z[0] + (static_cast<float>(a) * (z[1] - z[0]) + static_cast<float>(b) * (z[2] - z[0])) * invDet;
+            maxError = std::max(maxError, std::fabs(ctx.elevation(static_cast<size_t>(r), static_cast<size_t>(c)) - zi));
+        }
+    }
+    return maxError;
+}
+
+// Quadrants of a block, or halves when it is one cell thin.
+static size_t splitBlock(const QuadBlock& b, QuadBlock (&children)[4])
+{
+    const uint32_t rm = (b.r0 + b.r1) / 2, cm = (b.c0 + b.c1) / 2;
+    const bool splitRows = b.r1 - b.r0 >= 2, splitCols = b.c1 - b.c0 >= 2;
+    size_t n = 0;
+    if (splitRows && splitCols) {
+        children[n++] = { b.r0, b.c0, rm, cm, 0.0f };
+        children[n++] = { b.r0, cm, rm, b.c1, 0.0f };
+        children[n++] = { rm, b.c0, b.r1, cm, 0.0f };
+        children[n++] = { rm, cm, b.r1, b.c1, 0.0f };
+    } else if (splitCols) {
+        children[n++] = { b.r0, b.c0, b.r1, cm, 0.0f };
+        children[n++] = { b.r0, cm, b.r1, b.c1, 0.0f };
+    } else if (splitRows) {
+        children[n++] = { b.r0, b.c0, rm, b.c1, 0.0f };
+        children[n++] = { rm, b.c0, b.r1, b.c1, 0.0f };
+    }
+    return n;
+}
+
+// Accept 'b' or recurse into its children. A single cell has only its corners
+// as samples, so it is always exact.
+template <typename T>
+static void buildLeaves(const SimplifyContext<T>& ctx, QuadBlock b, std::vector<QuadBlock>& leaves)
+{
+    b.error = blockError(ctx, b);
+    QuadBlock children[4];
+    const size_t n = b.error > ctx.tolerance ? splitBlock(b, children) : 0;
+    if (n == 0) {
+        leaves.push_back(b);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) buildLeaves(ctx, children[i], leaves);
+}
+
+// Leaves of all 'blocks', one subtree per task on 'pool', sorted by corner so
+// the order does not depend on how the work was split.
+template <typename T>
+static std::vector<QuadBlock> buildLeaves(const SimplifyContext<T>& ctx, const std::vector<QuadBlock>& blocks, ThreadPool* pool)
+{
+    std::vector<std::vector<QuadBlock>> perBlock(blocks.size());
+    forBands(pool, blocks.size(), [&](size_t b0, size_t b1) {
+        for (size_t i = b0; i < b1; i++) buildLeaves(ctx, blocks[i], perBlock[i]);
+    });
+
+    std::vector<QuadBlock> leaves;
+    for (const auto& part : perBlock) leaves.insert(leaves.end(), part.begin(), part.end());
+    std::sort(leaves.begin(), leaves.end(), quadBlockBefore);
+    return leaves;
+}
+
+// Triangles of X,Y,Z covering the extra vertices on edges XY ('first', from X
+// to Y inclusive) and YZ ('second', from Y to Z inclusive): a fan from Z over
+// 'first' and, for its last segment, a fan from that segment's start over
+// 'second'. The winding of X,Y,Z is kept.
+static void stitchTriangle(const std::vector<uint32_t>& first, const std::vector<uint32_t>& second, std::vector<uint32_t>& out)
+{
+    const uint32_t z = second.back();
+    for (size_t i = 0; i + 2 < first.size(); i++) {
+        out.insert(out.end(), { first[i], first[i + 1], z });
+    }
+    const uint32_t apex = first[first.size() - 2];
+    for (size_t j = 0; j + 1 < second.size(); j++) {
+        out.insert(out.end(), { apex, second[j], second[j + 1] });
+    }
+}
+
+template <typename T>
+TerrainMesh simplifyTerrain(const GridView<T>& grid, float tolerance, ThreadPool* pool)
+{
+    if (grid.rows < 2 || grid.cols < 2) throw std::invalid_argument("grid must be at least 2x2 samples");
+    if (grid.sampleCount() > std::numeric_limits<uint32_t>::max()) throw std::invalid_argument("grid too large for 32-bit indices");
+    if (!(tolerance >= 0.0f)) throw std::invalid_argument("tolerance must be >= 0");
+
+    const GridNormalization g = prepareNormalization(grid, 1, pool);
+    const SimplifyContext<T> ctx{ grid, g.minElevation, tolerance };
+    const uint32_t rows = static_cast<uint32_t>(grid.rows), cols = static_cast<uint32_t>(grid.cols);
+
+    // Expand the root breadth-first until there are enough subtrees for the pool.
+    const size_t wanted = (pool && pool->size() > 1) ? 4 * pool->size() : 1;
+    std::vector<QuadBlock> blocks{ { 0, 0, rows - 1, cols - 1, 0.0f } }, accepted;
+    while (blocks.size() < wanted) {
+        std::vector<QuadBlock> next;
+        for (QuadBlock b : blocks) {
+            QuadBlock children[4];
+            b.error = blockError(ctx, b);
+            const size_t n = b.error > tolerance ? splitBlock(b, children) : 0;
+            if (n == 0) accepted.push_back(b);
+            next.insert(next.end(), children, children + n);
+        }
+        if (next.empty()) {
+            blocks.clear();
+            break;
+        }
+        blocks.swap(next);
+    }
+    // Blocks accepted on the way are checked again below; that costs no more
+    // than the expansion did and keeps a single code path.
+    blocks.insert(blocks.end(), accepted.begin(), accepted.end());
+    std::vector<QuadBlock> leaves = buildLeaves(ctx, blocks, pool);
+
+    // Stitch leaves to the corners of finer neighbours on their edges. The
+    // stitched triangles can exceed the tolerance; such leaves are split and
+    // everything is stitched again. Single cells never need stitching, so
+    // this terminates.
+    std::vector<uint8_t> isVertex;
+    std::vector<uint32_t> triangles;
+    float maxError = 0.0f;
+    for (;;) {
+        isVertex.assign(grid.sampleCount(), 0);
+        for (const QuadBlock& b : leaves) {
+            isVertex[b.r0 * cols + b.c0] = isVertex[b.r0 * cols + b.c1] = 1;
+            isVertex[b.r1 * cols + b.c0] = isVertex[b.r1 * cols + b.c1] = 1;
+        }
+
+        struct Band {
+            std::vector<uint32_t> triangles;
+            std::vector<size_t> split;
+            float maxError = 0.0f;
+        };
+        const size_t bandCount = (pool && pool->size() > 1) ? 4 * pool->size() : 1;
+        std::vector<Band> bands(std::min(bandCount, leaves.size()));
+        forBands(pool, bands.size(), [&](size_t k0, size_t k1) {
+            std::vector<uint32_t> top, right, bottom, left, stitched;
+            for (size_t k = k0; k < k1; k++) {
+                Band& band = bands[k];
+                for (size_t i = leaves.size() * k / bands.size(); i < leaves.size() * (k + 1) / bands.size(); i++) {
+                    const QuadBlock& b = leaves[i];
+                    const uint32_t A = b.r0 * cols + b.c0, B = b.r0 * cols + b.c1;
+                    const uint32_t C = b.r1 * cols + b.c0, D = b.r1 * cols + b.c1;
+                    // Edges in winding order: A->B, B->D, D->C, C->A.
+                    top.assign(1, A);
+                    for (uint32_t v = A + 1; v < B; v++) if (isVertex[v]) top.push_back(v);
+                    top.push_back(B);
+                    right.assign(1, B);
+                    for (uint32_t v = B + cols; v < D; v += cols) if (isVertex[v]) right.push_back(v);
+                    right.push_back(D);
+                    bottom.assign(1, D);
+                    for (uint32_t v = D - 1; v > C; v--) if (isVertex[v]) bottom.push_back(v);
+                    bottom.push_back(C);
+                    left.assign(1, C);
+                    for (uint32_t v = C - cols; v > A; v -= cols) if (isVertex[v]) left.push_back(v);
+                    left.push_back(A);
+
+                    stitched.clear();
+                    stitchTriangle(top, right, stitched);
+                    stitchTriangle(bottom, left, stitched);
+                    float error = b.error;
+                    if (stitched.size() > 6) {
+                        error = 0.0f;
+                        for (size_t t = 0; t < stitched.size(); t += 3) {
+                            const uint32_t tri[3] = { stitched[t], stitched[t + 1], stitched[t + 2] };
+                            error = std::max(error, triangleError(ctx, tri));
+                        }
+                        if (error > tolerance) {
+                            band.split.push_back(i);
+                            continue;
+                        }
+                    }
+                    band.maxError = std::max(band.maxError, error);
+                    band.triangles.insert(band.triangles.end(), stitched.begin(), stitched.end());
+                }
+            }
+        });
+
+        std::vector<uint8_t> replaced(leaves.size(), 0);
+        std::vector<QuadBlock> toSplit;
+        for (const Band& band : bands) {
+            for (const size_t i : band.split) {
+                QuadBlock children[4];
+                const size_t n = splitBlock(leaves[i], children);
+                toSplit.insert(toSplit.end(), children, children + n);
+                replaced[i] = 1;
+            }
+        }
+        if (toSplit.empty()) {
+            for (const Band& band : bands) {
+                triangles.insert(triangles.end(), band.triangles.begin(), band.triangles.end());
+                maxError = std::max(maxError, band.maxError);
+            }
+            break;
+        }
+        std::vector<QuadBlock> refined = buildLeaves(ctx, toSplit, pool);
+        for (size_t i = 0; i < leaves.size(); i++) {
+            if (!replaced[i]) refined.push_back(leaves[i]);
+        }
+        std::sort(refined.begin(), refined.end(), quadBlockBefore);
+        leaves.swap(refined);
+    }
+
+    // Vertices in row-major order; triangle corners are renumbered to them.
+    TerrainMesh mesh;
+    mesh.maxError = maxError;
+    std::vector<uint32_t> used;
+    for (uint32_t v = 0; v < isVertex.size(); v++) {
+        if (isVertex[v]) used.push_back(v);
+    }
+    mesh.vertices.reserve(used.size());
+    for (const uint32_t v : used) {
+        const size_t r = v / cols, c = v % cols;
+        mesh.vertices.emplace_back(normalizedCoord(c, g.invOffset, g.xBias), normalizedCoord(r, g.invOffset, g.yBias),
+            normalizeHeight(sampleValue(grid.at(r, c)), g.minElevation, g.zScale, g.zBias));
+    }
+    mesh.indices.resize(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        mesh.indices[i] = static_cast<uint32_t>(std::lower_bound(used.begin(), used.end(), triangles[i]) - used.begin());
+    }
+    return mesh;
+}
+
+template <typename T>
+TerrainMesh simplifyTerrain(const std::vector<T>& elevations, float tolerance, ThreadPool* pool)
+{
+    return simplifyTerrain(GridView<T>::square(elevations), tolerance, pool);
+}
+
+// Fill one void cell from the valid samples around it. Searches square rings
+// outwards; once the first valid sample is found at ring k, rings up to k*sqrt(2)
+// are still scanned, since they may hold samples at a smaller Euclidean distance.
+template <typename T>
+static bool fillVoidCell(std::vector<T>& elevations, size_t size, const VoidMask& voids,
+    size_t cx, size_t cy, VoidFill method, int maxRadius)
+{
+    const long n = static_cast<long>(size);
+    const long x0 = static_cast<long>(cx), y0 = static_cast<long>(cy);
+
+    long bestDist2 = -1;
+    double bestValue = 0.0, weightSum = 0.0, weightedSum = 0.0;
+    int limit = maxRadius;
+
+    for (int k = 1; k <= limit; k++) {
+        for (long dy = -k; dy <= k; dy++) {
+            const long y = y0 + dy;
+            if (y < 0 || y >= n) continue;
+            const bool edgeRow = (dy == -k || dy == k);
+            for (long dx = -k; dx <= k; dx += edgeRow ? 1 : 2 * k) {
+                const long x = x0 + dx;
+                if (x < 0 || x >= n) continue;
+                const size_t idx = static_cast<size_t>(y) * size + static_cast<size_t>(x);
+                if (voids.test(idx)) continue;
+
+                const long dist2 = dx * dx + dy * dy;
+                const double value = static_cast<double>(elevations[idx]);
+                if (bestDist2 < 0) {
+                    limit = std::min(maxRadius, static_cast<int>(std::ceil(k * 1.41421356237)));
+                }
+                if (bestDist2 < 0 || dist2 < bestDist2) {
+                    bestDist2 = dist2;
+                    bestValue = value;
+                }
+                const double w = 1.0 / static_cast<double>(dist2);
+                weightSum += w;
+                weightedSum += w * value;
+            }
+        }
+    }
+
+    if (bestDist2 < 0) return false;
+    double filled = (method == VoidFill::Nearest) ? bestValue : weightedSum / weightSum;
+    if (std::is_integral<T>::value) filled = std::round(filled);
+    elevations[cy * size + cx] = static_cast<T>(filled);
+    return true;
+}
+
+template <typename T>
+size_t fillVoids(std::vector<T>& elevations, const VoidMask& voids, VoidFill method, int maxRadius, ThreadPool* pool)
+{
+    if (elevations.empty()) return 0;
+    if (voids.size != elevations.size()) throw std::invalid_argument("void mask does not match elevations");
+    if (maxRadius < 1) throw std::invalid_argument("maxRadius must be >= 1");
+    const size_t size = GridView<T>::square(elevations).cols;
+
+    // Only masked cells are visited: split the mask words into bands and walk
+    // the set bits. Neighbours are read only where the mask is clear, so cells
+    // filled concurrently are never used as sources.
+    size_t total = 0;
+    std::mutex mutex;
+    forBands(pool, voids.words.size(), [&](size_t w0, size_t w1) {
+        size_t filled = 0;
+        for (size_t w = w0; w < w1; w++) {
+            for (uint64_t bits = voids.words[w]; bits; bits &= bits - 1) {
+                // Index of the lowest set bit.
+                const size_t idx = w * 64 + std::bitset<64>((bits & (~bits + 1)) - 1).count();
+                if (fillVoidCell(elevations, size, voids, idx % size, idx / size, method, maxRadius)) filled++;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total += filled;
+    });
+    return total;
+}
+
+template std::vector<Point> getNormalizePoints<float>(const std::vector<float>&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<int16_t>(const std::vector<int16_t>&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<float>(const std::vector<float>&, const HgtStats&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<int16_t>(const std::vector<int16_t>&, const HgtStats&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<float>(const std::vector<float>&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<int16_t>(const std::vector<int16_t>&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<float>(const std::vector<float>&, const HgtStats&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<int16_t>(const std::vector<int16_t>&, const HgtStats&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<float>(const std::vector<float>&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<int16_t>(const std::vector<int16_t>&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<float>(const std::vector<float>&, const HgtStats&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<int16_t>(const std::vector<int16_t>&, const HgtStats&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<float>(const GridView<float>&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<int16_t>(const GridView<int16_t>&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<HgtSample>(const GridView<HgtSample>&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<float>(const GridView<float>&, const HgtStats&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<int16_t>(const GridView<int16_t>&, const HgtStats&, int, ThreadPool*);
+template std::vector<Point> getNormalizePoints<HgtSample>(const GridView<HgtSample>&, const HgtStats&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<float>(const GridView<float>&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<int16_t>(const GridView<int16_t>&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<HgtSample>(const GridView<HgtSample>&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<float>(const GridView<float>&, const HgtStats&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<int16_t>(const GridView<int16_t>&, const HgtStats&, int, ThreadPool*);
+template PointsSoA getNormalizePointsSoA<HgtSample>(const GridView<HgtSample>&, const HgtStats&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<float>(const GridView<float>&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<int16_t>(const GridView<int16_t>&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<HgtSample>(const GridView<HgtSample>&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<float>(const GridView<float>&, const HgtStats&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<int16_t>(const GridView<int16_t>&, const HgtStats&, int, ThreadPool*);
+template HeightGrid getNormalizedHeights<HgtSample>(const GridView<HgtSample>&, const HgtStats&, int, ThreadPool*);
+template TerrainMesh simplifyTerrain<float>(const GridView<float>&, float, ThreadPool*);
+template TerrainMesh simplifyTerrain<int16_t>(const GridView<int16_t>&, float, ThreadPool*);
+template TerrainMesh simplifyTerrain<HgtSample>(const GridView<HgtSample>&, float, ThreadPool*);
+template TerrainMesh simplifyTerrain<float>(const std::vector<float>&, float, ThreadPool*);
+template TerrainMesh simplifyTerrain<int16_t>(const std::vector<int16_t>&, float, ThreadPool*);
+template size_t fillVoids<float>(std::vector<float>&, const VoidMask&, VoidFill, int, ThreadPool*);
+template size_t fillVoids<int16_t>(std::vector<int16_t>&, const VoidMask&, VoidFill, int, ThreadPool*);
@@ -1,17 +1,117 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
-
-// Simple 3D point used by DEM routines.
-struct Point {
-	float x_, y_, z_;
-	Point() = default;
-	Point(float x, float y, float z) : x_(x), y_(y), z_(z) {}
-};
+#include "Point.h"
+#include "HgtDecode.h"
+#include "GridView.h"
+#include "../Utils/ThreadPool.h"
 
 // Convert a square grid of elevation samples (row-major) into normalized 3D points.
 // - 'elevations' must contain N*N samples (N = sqrt(elevations.size())).
 // - 'step' controls subsampling: step==1 -> every sample, step>1 -> skip cells.
+// - T is float or int16_t (native SRTM metres); samples are converted to float
+//   only when the normalized coordinates are computed.
+// - SRTM voids are ignored for the elevation range and placed at its minimum.
+// - With a 'pool', the range scan and the output rows are split into bands
+//   processed in parallel; the result is bit-identical to the serial one.
 // Returns a vector of Points in row-major sampling order.
-std::vector<Point> getNormalizePoints(const std::vector<float>& elevations, int step);
\ No newline at end of file
+template <typename T>
+std::vector<Point> getNormalizePoints(const std::vector<T>& elevations, int step, ThreadPool* pool = nullptr);
+
+// Same, using the range from statistics gathered while decoding
+// (SrtmReader::getElevationTile) instead of scanning the samples again.
+template <typename T>
+std::vector<Point> getNormalizePoints(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+
+// Normalized points as separate coordinate streams, in the same order as
+// getNormalizePoints, for SIMD consumers.
+struct PointsSoA {
+    std::vector<float> x, y, z;
+    size_t size() const { return z.size(); }
+};
+
+// Normalized heights of the sampled grid only, row-major ('rows x cols').
+// X/Y are implied by the index and match getNormalizePoints exactly.
+struct HeightGrid {
+    size_t rows = 0, cols = 0;
+    size_t step = 1;         // grid cells between neighbouring samples
+    float invOffset = 1.0f;  // normalized units per grid cell
+    float xBias = 1.0f;      // normalized x of column 0 is -xBias
+    float yBias = 1.0f;      // normalized y of row 0 is -yBias
+    std::vector<float> z;
+
+    float x(size_t col) const { return static_cast<float>(col * step) * invOffset - xBias; }
+    float y(size_t row) const { return static_cast<float>(row * step) * invOffset - yBias; }
+    float at(size_t row, size_t col) const { return z[row * cols + col]; }
+};
+
+template <typename T>
+PointsSoA getNormalizePointsSoA(const std::vector<T>& elevations, int step, ThreadPool* pool = nullptr);
+template <typename T>
+PointsSoA getNormalizePointsSoA(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+
+template <typename T>
+HeightGrid getNormalizedHeights(const std::vector<T>& elevations, int step, ThreadPool* pool = nullptr);
+template <typename T>
+HeightGrid getNormalizedHeights(const std::vector<T>& elevations, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+
+// Overloads for any rows x cols grid or window (see GridView), including the
+// raw samples of a mapped tile (GridView<HgtSample>), normalized in place
+// without copying them into a square vector first. Both axes use one scale set
+// by the longer side: it spans [-1,1] and the shorter side is centred.
+// T is float, int16_t or HgtSample.
+template <typename T>
+std::vector<Point> getNormalizePoints(const GridView<T>& grid, int step, ThreadPool* pool = nullptr);
+template <typename T>
+std::vector<Point> getNormalizePoints(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+template <typename T>
+PointsSoA getNormalizePointsSoA(const GridView<T>& grid, int step, ThreadPool* pool = nullptr);
+template <typename T>
+PointsSoA getNormalizePointsSoA(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+template <typename T>
+HeightGrid getNormalizedHeights(const GridView<T>& grid, int step, ThreadPool* pool = nullptr);
+template <typename T>
+HeightGrid getNormalizedHeights(const GridView<T>& grid, const HgtStats& stats, int step, ThreadPool* pool = nullptr);
+
+class DemPyramid;
+
+// Level of detail 'level' of a pyramid: the same positions, sizes and
+// normalization as step 2^level over its base grid, but each height is the
+// mean of the block the sample stands for. Costs O(output).
+std::vector<Point> getNormalizePoints(const DemPyramid& pyramid, size_t level, ThreadPool* pool = nullptr);
+HeightGrid getNormalizedHeights(const DemPyramid& pyramid, size_t level, ThreadPool* pool = nullptr);
+
+// Adaptive, error-bounded triangulation of a grid. Vertices are grid samples,
+// normalized exactly like getNormalizePoints with step 1; 'indices' holds
+// three vertex indices per triangle, all wound the same way.
+struct TerrainMesh {
+    std::vector<Point> vertices;
+    std::vector<uint32_t> indices;
+    float maxError = 0.0f; // largest vertical error of any sample, in elevation units
+
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Quadtree simplification: a block is kept as two triangles when every sample
+// in it lies within 'tolerance' (elevation units, e.g. metres) of them, and is
+// split into quadrants otherwise. Blocks next to finer ones are stitched to
+// their extra edge vertices, so the mesh has no cracks, and the tolerance
+// holds for the stitched triangles too. Runs in O(n log n); with a 'pool' the
+// top-level quadrants are simplified in parallel. The result does not depend
+// on the pool. Voids are placed at the elevation minimum as in getNormalizePoints.
+template <typename T>
+TerrainMesh simplifyTerrain(const GridView<T>& grid, float tolerance, ThreadPool* pool = nullptr);
+template <typename T>
+TerrainMesh simplifyTerrain(const std::vector<T>& elevations, float tolerance, ThreadPool* pool = nullptr);
+
+enum class VoidFill { Nearest, InverseDistance };
+
+// Replace the void samples of a square grid (bits set in 'voids') in place,
+// from the valid samples within 'maxRadius' cells: either the nearest one or an
+// inverse-distance-squared average. Only masked cells are visited, in bands of
+// mask words on 'pool' if given. Voids with no valid sample in range are left
+// as they are. Returns the number of samples filled.
+template <typename T>
+size_t fillVoids(std::vector<T>& elevations, const VoidMask& voids, VoidFill method, int maxRadius = 32, ThreadPool* pool = nullptr);
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "DemMosaic.h"
+#include "SrtmReader.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+
+// Floor division for possibly negative sample indices.
+static int64_t floorDiv(int64_t a, int64_t b)
+{
+    const int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+DemMosaic::DemMosaic(const std::string& directory, size_t tileSize, size_t memoryBudgetBytes, Storage storage)
+    : directory_(directory), tileSize_(tileSize), storage_(storage), memoryBudget_(memoryBudgetBytes)
+{
+    if (tileSize_ < 2) throw std::invalid_argument("tileSize must be >= 2");
+}
+
+float DemMosaic::elevationAt(double lat, double lon)
+{
+    const double perDegree = static_cast<double>(tileSize_ - 1);
+    return sampleAt(std::llround(lat * perDegree), std::llround(lon * perDegree));
+}
+
+float DemMosaic::sampleAt(int64_t gy, int64_t gx)
+{
+    const int64_t perDegree = static_cast<int64_t>(tileSize_ - 1);
+
+    // Each tile owns its northern row (row 0) and western column (col 0);
+    // its southern row and eastern column are read from the neighbours.
+    const int64_t tileLat = floorDiv(gy - 1, perDegree);
+    const int64_t tileLon = floorDiv(gx, perDegree);
+    const size_t row = static_cast<size_t>((tileLat + 1) * perDegree - gy);
+    const size_t col = static_cast<size_t>(gx - tileLon * perDegree);
+
+    const auto t = tile(static_cast<int>(tileLat), static_cast<int>(tileLon));
+    return t ? t->at(row, col) : kVoidElevation;
+}
+
+std::shared_ptr<const DemTile> DemMosaic::tile(int lat, int lon)
+{
+    const int k = key(lat, lon);
+    const auto it = cache_.find(k);
+    if (it != cache_.end()) {
+        hits_++;
+        lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+        return it->second.tile;
+    }
+
+    misses_++;
+    std::shared_ptr<const DemTile> loaded = loadTile(lat, lon);
+    insert(k, loaded);
+    return loaded;
+}
+
+std::shared_ptr<const DemTile> DemMosaic::loadTile(int lat, int lon) const
+{
+    const std::string path = tilePath(lat, lon);
+    if (!std::filesystem::exists(path)) return nullptr;
+
+    SrtmReader reader(path, tileSize_);
+    auto t = std::make_shared<DemTile>();
+    t->lat = lat;
+    t->lon = lon;
+    t->size = tileSize_;
+    if (storage_ == Storage::Decoded) {
+        t->samples = reader.getElevationData<int16_t>();
+    } else {
+        t->view = reader.openTileView();
+    }
+    return t;
+}
+
+void DemMosaic::insertTile(int lat, int lon, std::shared_ptr<const DemTile> tile)
+{
+    if (tile && (tile->size != tileSize_ || tile->lat != lat || tile->lon != lon)) {
+        throw std::invalid_argument("Tile does not match mosaic slot: " + tileName(lat, lon));
+    }
+
+    const int k = key(lat, lon);
+    if (cache_.count(k)) return;
+    insert(k, std::move(tile));
+}
+
+bool DemMosaic::isCached(int lat, int lon) const
+{
+    return cache_.count(key(lat, lon)) != 0;
+}
+
+std::string DemMosaic::tileName(int lat, int lon)
+{
+    if (lat < -90 || lat > 90 || lon < -180 || lon > 180) {
+        throw std::out_of_range("Tile coordinates out of range: " + std::to_string(lat) + ", " + std::to_string(lon));
+    }
+
+    char name[16];
+    std::snprintf(name, sizeof(name), "%c%02d%c%03d",
+        lat >= 0 ? 'N' : 'S', std::abs(lat), lon >= 0 ? 'E' : 'W', std::abs(lon));
+    return name;
+}
+
+std::string DemMosaic::tilePath(int lat, int lon) const
+{
+    return (std::filesystem::path(directory_) / (tileName(lat, lon) + ".hgt")).string();
+}
+
+void DemMosaic::setMemoryBudget(size_t bytes)
+{
+    memoryBudget_ = bytes;
+    evict();
+}
+
+DemMosaic::Stats DemMosaic::stats() const
+{
+    Stats s;
+    s.hits = hits_;
+    s.misses = misses_;
+    s.evictions = evictions_;
+    s.tilesCached = cache_.size();
+    s.bytesCached = bytesCached_;
+    return s;
+}
+
+void DemMosaic::resetStats()
+{
+    hits_ = 0;
+    misses_ = 0;
+    evictions_ = 0;
+}
+
+void DemMosaic::insert(int k, std::shared_ptr<const DemTile> tile)
+{
+    lru_.push_front(k);
+    bytesCached_ += tile ? tile->bytes() : 0;
+    cache_[k] = Entry{ std::move(tile), lru_.begin() };
+    evict();
+}
+
+void DemMosaic::evict()
+{
+    // The most recently used tile is always kept, even if it alone exceeds the budget.
+    while (bytesCached_ > memoryBudget_ && lru_.size() > 1) {
+        const int k = lru_.back();
+        const auto it = cache_.find(k);
+        bytesCached_ -= it->second.tile ? it->second.tile->bytes() : 0;
+        cache_.erase(it);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SrtmTileView.h"
+
+// One loaded 1x1 degree SRTM tile. 'lat'/'lon' are the integer degrees of the
+// south-west corner, as in the tile name (N35W116 -> lat 35, lon -116).
+// Row 0 is the northern edge, column 0 the western edge.
+struct DemTile {
+    int lat = 0;
+    int lon = 0;
+    size_t size = 0;
+    SrtmTileView view;          // set when the tile is memory-mapped
+    std::vector<int16_t> samples; // set when the tile is fully decoded (native metres)
+
+    int16_t raw(size_t row, size_t col) const
+    {
+        return samples.empty() ? view.at(row, col) : samples[row * size + col];
+    }
+
+    float at(size_t row, size_t col) const { return static_cast<float>(raw(row, col)); }
+
+    // Bytes charged against the mosaic memory budget.
+    size_t bytes() const { return samples.empty() ? view.sampleCount() * 2 : samples.size() * sizeof(int16_t); }
+};
+
+// Seamless elevation lookups over a directory of SRTM tiles.
+// Tiles are resolved from geographic coordinates, loaded on first use and kept
+// in an LRU cache bounded by a memory budget. Neighbouring tiles share their
+// edge rows/columns; each shared sample is read from exactly one owning tile
+// (the one it is the northern row / western column of), so lookups are
+// continuous across edges.
+class DemMosaic
+{
+public:
+    enum class Storage { Mapped, Decoded };
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t tilesCached = 0;
+        size_t bytesCached = 0;
+    };
+
+    // SRTM void value, returned where no tile exists (e.g. open ocean).
+    static constexpr float kVoidElevation = -32768.0f;
+
+    DemMosaic(const std::string& directory, size_t tileSize, size_t memoryBudgetBytes,
+        Storage storage = Storage::Mapped);
+
+    // Elevation of the sample nearest to (lat, lon) in degrees.
+    float elevationAt(double lat, double lon);
+
+    // Elevation at a global sample index: 'gy' counts samples north of the
+    // equator, 'gx' samples east of the prime meridian ((tileSize-1) per degree).
+    float sampleAt(int64_t gy, int64_t gx);
+
+    // Tile whose south-west corner is (lat, lon), loading it if needed.
+    // Returns nullptr if the file does not exist.
+    std::shared_ptr<const DemTile> tile(int lat, int lon);
+
+    // Load a tile from disk without touching the cache. Only reads the mosaic
+    // configuration, so it may be called from a loader thread.
+    std::shared_ptr<const DemTile> loadTile(int lat, int lon) const;
+
+    // Insert the result of loadTile() (e.g. from a background loader).
+    // A nullptr 'tile' records the tile as missing.
+    void insertTile(int lat, int lon, std::shared_ptr<const DemTile> tile);
+
+    bool isCached(int lat, int lon) const;
+
+    // Tile name for a south-west corner, e.g. (35, -116) -> "N35W116".
+    // Throws std::out_of_range unless |lat| <= 90 and |lon| <= 180.
+    static std::string tileName(int lat, int lon);
+    std::string tilePath(int lat, int lon) const;
+
+    size_t tileSize() const { return tileSize_; }
+    size_t memoryBudget() const { return memoryBudget_; }
+    void setMemoryBudget(size_t bytes);
+    Stats stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        std::shared_ptr<const DemTile> tile; // nullptr caches a missing file
+        std::list<int>::iterator lruPos;
+    };
+
+    static int key(int lat, int lon) { return (lat + 90) * 360 + (lon + 180); }
+    void insert(int k, std::shared_ptr<const DemTile> tile);
+    void evict();
+
+    const std::string directory_;
+    const size_t tileSize_;
+    const Storage storage_;
+    size_t memoryBudget_;
+
+    std::unordered_map<int, Entry> cache_;
+    std::list<int> lru_; // most recently used first
+    size_t bytesCached_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t evictions_ = 0;
+};
@@ -0,0 +1,92 @@
+#include "DemPyramid.h"
+#include "HgtDecode.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+// Level k+1 from level k: each output cell merges up to 2x2 input cells,
+// weighting the means by their valid sample counts.
+static PyramidLevel reduceLevel(const PyramidLevel& src, ThreadPool* pool)
+{
+    const float voidValue = static_cast<float>(kHgtVoid);
+    PyramidLevel dst;
+    dst.rows = (src.rows + 1) / 2;
+    dst.cols = (src.cols + 1) / 2;
+    dst.scale = src.scale * 2;
+    dst.minimum.resize(dst.rows * dst.cols);
+    dst.maximum.resize(dst.rows * dst.cols);
+    dst.mean.resize(dst.rows * dst.cols);
+    dst.validCount.resize(dst.rows * dst.cols);
+
+    // Level 0 has no min/max/count arrays: each sample is its own aggregate.
+    const float* srcMin = src.minimum.empty() ? src.mean.data() : src.minimum.data();
+    const float* srcMax = src.maximum.empty() ? src.mean.data() : src.maximum.data();
+    const float* srcMean = src.mean.data();
+    const uint32_t* srcCount = src.validCount.empty() ? nullptr : src.validCount.data();
+
+    forBands(pool, dst.rows, [&](size_t r0, size_t r1) {
+        for (size_t r = r0; r < r1; r++) {
+            const size_t sr0 = 2 * r, sr1 = std::min(2 * r + 2, src.rows);
+            for (size_t c = 0; c < dst.cols; c++) {
+                const size_t sc0 = 2 * c, sc1 = std::min(2 * c + 2, src.cols);
+                float lo = std::numeric_limits<float>::max();
+                float hi = std::numeric_limits<float>::lowest();
+                float sum = 0.0f;
+                uint32_t count = 0;
+                for (size_t sr = sr0; sr < sr1; sr++) {
+                    for (size_t sc = sc0; sc < sc1; sc++) {
+                        const size_t i = sr * src.cols + sc;
+                        const uint32_t n = srcCount ? srcCount[i] : (srcMean[i] != voidValue ? 1u : 0u);
+                        if (n == 0) continue;
+                        lo = std::min(lo, srcMin[i]);
+                        hi = std::max(hi, srcMax[i]);
+                        sum += srcMean[i] * static_cast<float>(n);
+                        count += n;
+                    }
+                }
+                const size_t o = r * dst.cols + c;
+                dst.minimum[o] = count ? lo : voidValue;
+                dst.maximum[o] = count ? hi : voidValue;
+                dst.mean[o] = count ? sum / static_cast<float>(count) : voidValue;
+                dst.validCount[o] = count;
+            }
+        }
+    });
+    return dst;
+}
+
+template <typename T>
+DemPyramid::DemPyramid(const GridView<T>& base, ThreadPool* pool)
+{
+    if (base.rows == 0 || base.cols == 0) throw std::invalid_argument("DemPyramid needs a non-empty grid");
+
+    PyramidLevel level0;
+    level0.rows = base.rows;
+    level0.cols = base.cols;
+    level0.mean.resize(base.sampleCount());
+    forBands(pool, base.rows, [&](size_t r0, size_t r1) {
+        for (size_t r = r0; r < r1; r++) {
+            const T* row = base.row(r);
+            float* out = level0.mean.data() + r * base.cols;
+            for (size_t c = 0; c < base.cols; c++) out[c] = sampleValue(row[c]);
+        }
+    });
+    levels_.push_back(std::move(level0));
+
+    while (levels_.back().rows > 1 || levels_.back().cols > 1) {
+        levels_.push_back(reduceLevel(levels_.back(), pool));
+    }
+}
+
+bool DemPyramid::elevationRange(float& minElevation, float& maxElevation) const
+{
+    const PyramidLevel& top = levels_.back();
+    const bool valid = top.validCount.empty() ? top.mean[0] != static_cast<float>(kHgtVoid) : top.validCount[0] > 0;
+    minElevation = top.minView().at(0, 0);
+    maxElevation = top.maxView().at(0, 0);
+    return valid;
+}
+
+template DemPyramid::DemPyramid(const GridView<float>&, ThreadPool*);
+template DemPyramid::DemPyramid(const GridView<int16_t>&, ThreadPool*);
+template DemPyramid::DemPyramid(const GridView<HgtSample>&, ThreadPool*);
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GridView.h"
+#include "../Utils/ThreadPool.h"
+
+// One level of a DemPyramid. Cell (r, c) of level k aggregates the base
+// samples [r*2^k, (r+1)*2^k) x [c*2^k, (c+1)*2^k), clipped to the grid.
+// Voids are left out of every aggregate; cells with no valid sample hold
+// kHgtVoid. Level 0 only stores 'mean' (the samples themselves).
+struct PyramidLevel {
+    size_t rows = 0, cols = 0;
+    size_t scale = 1;                  // base samples per cell side (2^level)
+    std::vector<float> minimum, maximum, mean;
+    std::vector<uint32_t> validCount;  // valid base samples per cell
+
+    GridView<float> minView() const { return view(minimum.empty() ? mean : minimum); }
+    GridView<float> maxView() const { return view(maximum.empty() ? mean : maximum); }
+    GridView<float> meanView() const { return view(mean); }
+
+private:
+    GridView<float> view(const std::vector<float>& v) const { return GridView<float>(v.data(), rows, cols); }
+};
+
+// Multi-resolution copy of an elevation grid built once with 2x2 min/max/mean
+// reductions, so any power-of-two level of detail is a view over a
+// precomputed level instead of a pass over the full grid. Levels halve until
+// a single cell remains. Level 0 is a float copy of the base (4 B per sample,
+// twice an int16 SRTM tile); every higher cell holds min, max, mean and a
+// count (16 B), so levels 1+ add about 4/3 of level 0. For an SRTM1 tile that
+// is roughly 52 MB + 69 MB, about 4.7 times the 26 MB of native samples.
+class DemPyramid
+{
+public:
+    // Build all levels from 'base' (T is float, int16_t or HgtSample), each
+    // level in row bands on 'pool' if given.
+    template <typename T>
+    explicit DemPyramid(const GridView<T>& base, ThreadPool* pool = nullptr);
+
+    size_t levelCount() const { return levels_.size(); }
+    const PyramidLevel& level(size_t k) const { return levels_.at(k); }
+
+    size_t rows() const { return levels_.front().rows; }
+    size_t cols() const { return levels_.front().cols; }
+
+    // Void-aware elevation range of the whole grid; false if it is all void.
+    bool elevationRange(float& minElevation, float& maxElevation) const;
+
+private:
+    std::vector<PyramidLevel> levels_;
+};
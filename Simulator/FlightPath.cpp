@@ -1,15 +1,8 @@
 #include "FlightPath.h"
 #include <algorithm>
 
-FlightPath::FlightPath(int minX, int minY, int maxX, int maxY, float altitude, unsigned int seed)
-	: minX_(minX), minY_(minY), maxX_(maxX), maxY_(maxY), altitude_(altitude) {
-	if (seed == 0) {
-		rng_.seed(seed);
-	}
-	else {
-        std::random_device rnd;
-		rng_.seed(rnd());
-	}
+FlightPath::FlightPath(int minX, int minY, int maxX, int maxY, float altitude, uint64_t seed)
+	: minX_(minX), minY_(minY), maxX_(maxX), maxY_(maxY), altitude_(altitude), rng_(seed) {
 }
 
 std::vector<Point> FlightPath::GenerateFlightPath() const
@@ -21,11 +14,11 @@ std::vector<Point> FlightPath::GenerateFlightPath() const
 	if (minY > maxY) std::swap(minY, maxY);
 
 	// Start and end coordinates sampled inside the provided ranges
-	float startX = GenerateRandomNumber(minX, maxX);
-	float startY = GenerateRandomNumber(minY, maxY);
+	float startX = GenerateRandomNumber(minX, maxX, rng_.uniform(0, kEndpointStream));
+	float startY = GenerateRandomNumber(minY, maxY, rng_.uniform(1, kEndpointStream));
 
-	float endX = GenerateRandomNumber(minX, maxX);
-	float endY = GenerateRandomNumber(minY, maxY);
+	float endX = GenerateRandomNumber(minX, maxX, rng_.uniform(2, kEndpointStream));
+	float endY = GenerateRandomNumber(minY, maxY, rng_.uniform(3, kEndpointStream));
 
 	std::vector<Point> result;
 	result.reserve(2);
@@ -36,9 +29,8 @@ std::vector<Point> FlightPath::GenerateFlightPath() const
 	return result;
 }
 
-float FlightPath::GenerateRandomNumber(int min, int max) const
+float FlightPath::GenerateRandomNumber(int min, int max, float uniform)
 {
-	// uniform real in [min, max]
-	std::uniform_real_distribution<float> dist(static_cast<float>(min), static_cast<float>(max));
-	return dist(rng_);
+	// uniform real in [min, max)
+	return static_cast<float>(min) + (static_cast<float>(max) - static_cast<float>(min)) * uniform;
 }
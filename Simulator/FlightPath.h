@@ -1,29 +1,28 @@
 #pragma once
+#include <cstdint>
 #include <vector>
-#include <random>
+#include "Point.h"
+#include "../Utils/PhiloxRng.h"
 
-struct Point {
-	float x_, y_, z_; 
-	Point() = default;
-	Point(float x, float y, float z)
-		: x_(x), y_(y), z_(z) {
-	}
-};
-
-// Simple FlightPath generator that returns a flat vector of floats:
-// { startX, startY, altitude, endX, endY, altitude }
+// Simple FlightPath generator that returns the two endpoints of a straight
+// flight line: { start, end }, both at 'altitude'.
+// The endpoints are a pure function of the seed, so GenerateFlightPath()
+// gives the same line on every call and from any thread.
 class FlightPath
 {
 public:
-	FlightPath(int minX, int minY, int maxX, int maxY, float altitude, unsigned int seed);
+	FlightPath(int minX, int minY, int maxX, int maxY, float altitude, uint64_t seed);
 	std::vector<Point> GenerateFlightPath() const;
 
+	// PhiloxRng stream of the endpoint draws; indices 0..3 are start x, start
+	// y, end x and end y.
+	static constexpr uint32_t kEndpointStream = 0;
+
 private:
-	// GenerateRandomNumber now accepts an explicit min/max range.
-	float GenerateRandomNumber(int min, int max) const;
+	// Maps a uniform value in [0, 1) to [min, max).
+	static float GenerateRandomNumber(int min, int max, float uniform);
 
 	int minX_, minY_, maxX_, maxY_;
 	float altitude_;
-	mutable std::mt19937 rng_;
+	PhiloxRng rng_;
 };
-
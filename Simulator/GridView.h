@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "SrtmTileView.h"
+
+// One SRTM sample exactly as stored in the file (big-endian int16), so a
+// GridView can point straight into a mapped tile.
+struct HgtSample {
+    uint8_t hi, lo;
+    int16_t value() const { return static_cast<int16_t>((static_cast<uint16_t>(hi) << 8) | lo); }
+};
+
+// Sample value in elevation units, whatever the storage.
+template <typename T>
+inline float sampleValue(const T& sample)
+{
+    return static_cast<float>(sample);
+}
+
+inline float sampleValue(const HgtSample& sample)
+{
+    return static_cast<float>(sample.value());
+}
+
+// Non-owning view of a row-major elevation grid, or of a rectangular window
+// of one. 'stride' is the number of samples between the starts of two
+// consecutive rows, so a window shares the parent's storage.
+template <typename T>
+struct GridView {
+    const T* data = nullptr;
+    size_t rows = 0, cols = 0, stride = 0;
+
+    GridView() = default;
+    GridView(const T* data, size_t rows, size_t cols, size_t stride)
+        : data(data), rows(rows), cols(cols), stride(stride) {
+    }
+    GridView(const T* data, size_t rows, size_t cols)
+        : GridView(data, rows, cols, cols) {
+    }
+
+    // View of a square row-major grid; throws if the size is not a perfect square.
+    static GridView square(const std::vector<T>& samples)
+    {
+        const size_t size = static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(samples.size()))));
+        if (size * size != samples.size()) {
+            throw std::invalid_argument("elevations.size() must be a perfect square");
+        }
+        return GridView(samples.data(), size, size);
+    }
+
+    const T* row(size_t r) const { return data + r * stride; }
+    const T& at(size_t r, size_t c) const { return data[r * stride + c]; }
+    size_t sampleCount() const { return rows * cols; }
+
+    // The 'h x w' window whose top-left sample is (r0, c0).
+    GridView window(size_t r0, size_t c0, size_t h, size_t w) const
+    {
+        if (r0 > rows || h > rows - r0 || c0 > cols || w > cols - c0) {
+            throw std::out_of_range("Window outside grid");
+        }
+        return GridView(data + r0 * stride + c0, h, w, stride);
+    }
+};
+
+// A GridView over float, int16_t or HgtSample samples, for classes that keep
+// a grid without being templates themselves. visit() calls back with the typed
+// view, so inner loops still read the native samples without a float copy.
+struct AnyGridView {
+    enum class Storage { Float, Int16, Hgt };
+
+    const void* data = nullptr;
+    size_t rows = 0, cols = 0, stride = 0;
+    Storage storage = Storage::Float;
+
+    AnyGridView() = default;
+    template <typename T>
+    AnyGridView(const GridView<T>& grid)
+        : data(grid.data), rows(grid.rows), cols(grid.cols), stride(grid.stride), storage(storageOf<T>()) {
+    }
+
+    template <typename T>
+    GridView<T> as() const { return GridView<T>(static_cast<const T*>(data), rows, cols, stride); }
+
+    // fn(const GridView<T>&) with the stored sample type.
+    template <class F>
+    decltype(auto) visit(F&& fn) const
+    {
+        switch (storage) {
+        case Storage::Int16: return fn(as<int16_t>());
+        case Storage::Hgt: return fn(as<HgtSample>());
+        default: return fn(as<float>());
+        }
+    }
+
+    float at(size_t r, size_t c) const
+    {
+        return visit([r, c](const auto& grid) { return sampleValue(grid.at(r, c)); });
+    }
+
+private:
+    template <typename T>
+    static constexpr Storage storageOf()
+    {
+        static_assert(std::is_same<T, float>::value || std::is_same<T, int16_t>::value || std::is_same<T, HgtSample>::value,
+            "AnyGridView holds float, int16_t or HgtSample samples");
+        return std::is_same<T, int16_t>::value ? Storage::Int16 : std::is_same<T, HgtSample>::value ? Storage::Hgt : Storage::Float;
+    }
+};
+
+// View of all samples of a mapped tile, without decoding them.
+inline GridView<HgtSample> gridView(const SrtmTileView& tile)
+{
+    return GridView<HgtSample>(reinterpret_cast<const HgtSample*>(tile.data()), tile.size(), tile.size());
+}
@@ -0,0 +1,269 @@
+#include "HeightSampler.h"
+#include "../Utils/CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+template <typename T>
+HeightSampler::HeightSampler(const GridView<T>& grid, const VoidMask* voids)
+    : grid_(grid), voids_(voids)
+{
+    if (grid.rows < 2 || grid.cols < 2) throw std::invalid_argument("HeightSampler needs at least 2x2 samples");
+    // The gather kernels use 32-bit sample indices.
+    const size_t span = (grid.rows - 1) * grid.stride + grid.cols;
+    if (span > static_cast<size_t>(std::numeric_limits<int32_t>::max())) throw std::invalid_argument("grid too large for HeightSampler");
+    if (voids && voids->size < span) throw std::invalid_argument("void mask does not cover the grid");
+}
+
+template <typename T>
+static bool isVoid(const GridView<T>& grid, const VoidMask* voids, size_t idx)
+{
+    return sampleValue(grid.data[idx]) == static_cast<float>(kHgtVoid) || (voids && voids->test(idx));
+}
+
+// Clamp a coordinate to [0, n-1] and split it into the lower sample index
+// (at most n-2, so idx+1 exists) and the fraction past it. NaN maps to 0,
+// as with the vector max.
+static void splitCoord(float v, size_t n, int32_t& i, float& f)
+{
+    v = std::min(v > 0.0f ? v : 0.0f, static_cast<float>(n - 1));
+    i = std::min(static_cast<int32_t>(v), static_cast<int32_t>(n - 2));
+    f = v - static_cast<float>(i);
+}
+
+// Catmull-Rom weights for the samples at -1, 0, 1, 2 around fraction t.
+static void cubicWeights(float t, float (&w)[4])
+{
+    w[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+    w[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+    w[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+    w[3] = (0.5f * t - 0.5f) * t * t;
+}
+
+template <typename T>
+static float bilinear(const GridView<T>& grid, const VoidMask* voids, float col, float row)
+{
+    int32_t x0, y0;
+    float fx, fy;
+    splitCoord(col, grid.cols, x0, fx);
+    splitCoord(row, grid.rows, y0, fy);
+
+    const size_t idx = static_cast<size_t>(y0) * grid.stride + static_cast<size_t>(x0);
+    const size_t corner[4] = { idx, idx + 1, idx + grid.stride, idx + grid.stride + 1 };
+    const float weight[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+
+    float sum = 0.0f, weightSum = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        if (isVoid(grid, voids, corner[i])) continue;
+        sum += weight[i] * sampleValue(grid.data[corner[i]]);
+        weightSum += weight[i];
+    }
+    return weightSum > 0.0f ? sum / weightSum : static_cast<float>(kHgtVoid);
+}
+
+template <typename T>
+static float bicubic(const GridView<T>& grid, const VoidMask* voids, float col, float row)
+{
+    int32_t x0, y0;
+    float fx, fy;
+    splitCoord(col, grid.cols, x0, fx);
+    splitCoord(row, grid.rows, y0, fy);
+
+    float wx[4], wy[4];
+    cubicWeights(fx, wx);
+    cubicWeights(fy, wy);
+
+    const int32_t lastCol = static_cast<int32_t>(grid.cols - 1), lastRow = static_cast<int32_t>(grid.rows - 1);
+    float sum = 0.0f;
+    for (int j = 0; j < 4; j++) {
+        const size_t r = static_cast<size_t>(std::min(std::max(y0 - 1 + j, 0), lastRow));
+        float rowSum = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            const size_t idx = r * grid.stride + static_cast<size_t>(std::min(std::max(x0 - 1 + i, 0), lastCol));
+            if (isVoid(grid, voids, idx)) return bilinear(grid, voids, col, row);
+            rowSum += wx[i] * sampleValue(grid.data[idx]);
+        }
+        sum += wy[j] * rowSum;
+    }
+    return sum;
+}
+
+template <typename T>
+static float sampleOne(const GridView<T>& grid, const VoidMask* voids, float col, float row, HeightSampler::Filter filter)
+{
+    return filter == HeightSampler::Filter::Bicubic ? bicubic(grid, voids, col, row) : bilinear(grid, voids, col, row);
+}
+
+float HeightSampler::sample(float col, float row, Filter filter) const
+{
+    return grid_.visit([&](const auto& grid) { return sampleOne(grid, voids_, col, row, filter); });
+}
+
+void HeightSampler::sampleScalar(const float* cols, const float* rows, float* heights, size_t n, Filter filter) const
+{
+    grid_.visit([&](const auto& grid) {
+        for (size_t i = 0; i < n; i++) {
+            heights[i] = sampleOne(grid, voids_, cols[i], rows[i], filter);
+        }
+    });
+}
+
+#if SIM_X86
+// Vector splitCoord: lower sample indices and fractions for 8 coordinates.
+SIM_TARGET_AVX2 static void splitCoordAvx2(__m256 v, size_t n, __m256i& i, __m256& f)
+{
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(static_cast<float>(n - 1)));
+    i = _mm256_min_epi32(_mm256_cvttps_epi32(v), _mm256_set1_epi32(static_cast<int32_t>(n - 2)));
+    f = _mm256_sub_ps(v, _mm256_cvtepi32_ps(i));
+}
+
+// Samples at 'idx' as floats. 16-bit storage is read with 32-bit gathers at
+// 2-byte scale, leaving the sample's bytes in bits 16..31 of each lane; the
+// lane at 'last' (the view's final sample) reads the pair ending there, so
+// nothing past the grid is touched.
+SIM_TARGET_AVX2 static __m256 gatherSamples(const float* data, __m256i idx, __m256i)
+{
+    return _mm256_i32gather_ps(data, idx, 4);
+}
+
+SIM_TARGET_AVX2 static __m256i gatherPairsHigh(const void* data, __m256i idx, __m256i last)
+{
+    const __m256i atEnd = _mm256_cmpeq_epi32(idx, last);
+    const __m256i words = _mm256_i32gather_epi32(static_cast<const int*>(data), _mm256_add_epi32(idx, atEnd), 2);
+    return _mm256_sllv_epi32(words, _mm256_andnot_si256(atEnd, _mm256_set1_epi32(16)));
+}
+
+SIM_TARGET_AVX2 static __m256 gatherSamples(const int16_t* data, __m256i idx, __m256i last)
+{
+    return _mm256_cvtepi32_ps(_mm256_srai_epi32(gatherPairsHigh(data, idx, last), 16));
+}
+
+SIM_TARGET_AVX2 static __m256 gatherSamples(const HgtSample* data, __m256i idx, __m256i last)
+{
+    // Big-endian: bits 16..23 hold the high byte, 24..31 the low one.
+    const __m256i w = gatherPairsHigh(data, idx, last);
+    const __m256i hi = _mm256_slli_epi32(_mm256_srai_epi32(_mm256_slli_epi32(w, 8), 24), 8);
+    return _mm256_cvtepi32_ps(_mm256_or_si256(hi, _mm256_srli_epi32(w, 24)));
+}
+
+// Lanes whose sample at 'idx' is valid (all bits set) or void (zero).
+SIM_TARGET_AVX2 static __m256 validLanes(__m256 z, __m256i idx, const VoidMask* voids)
+{
+    __m256 valid = _mm256_cmp_ps(z, _mm256_set1_ps(static_cast<float>(kHgtVoid)), _CMP_NEQ_UQ);
+    if (voids) {
+        // Bit idx of the mask is bit (idx & 31) of 32-bit word idx >> 5 (little-endian words).
+        const __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int*>(voids->words.data()), _mm256_srli_epi32(idx, 5), 4);
+        const __m256i bit = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(idx, _mm256_set1_epi32(31))), _mm256_set1_epi32(1));
+        valid = _mm256_and_ps(valid, _mm256_castsi256_ps(_mm256_cmpeq_epi32(bit, _mm256_setzero_si256())));
+    }
+    return valid;
+}
+
+template <typename T>
+SIM_TARGET_AVX2 static __m256 bilinearAvx2(const GridView<T>& grid, const VoidMask* voids, __m256i last, __m256 col, __m256 row)
+{
+    __m256i x0, y0;
+    __m256 fx, fy;
+    splitCoordAvx2(col, grid.cols, x0, fx);
+    splitCoordAvx2(row, grid.rows, y0, fy);
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i stride = _mm256_set1_epi32(static_cast<int32_t>(grid.stride));
+    const __m256i idx00 = _mm256_add_epi32(_mm256_mullo_epi32(y0, stride), x0);
+    const __m256i idx[4] = { idx00, _mm256_add_epi32(idx00, _mm256_set1_epi32(1)), _mm256_add_epi32(idx00, stride),
+        _mm256_add_epi32(idx00, _mm256_add_epi32(stride, _mm256_set1_epi32(1))) };
+    const __m256 gx = _mm256_sub_ps(one, fx), gy = _mm256_sub_ps(one, fy);
+    const __m256 weight[4] = { _mm256_mul_ps(gx, gy), _mm256_mul_ps(fx, gy), _mm256_mul_ps(gx, fy), _mm256_mul_ps(fx, fy) };
+
+    __m256 sum = _mm256_setzero_ps(), weightSum = _mm256_setzero_ps();
+    for (int i = 0; i < 4; i++) {
+        const __m256 z = gatherSamples(grid.data, idx[i], last);
+        const __m256 w = _mm256_and_ps(weight[i], validLanes(z, idx[i], voids));
+        sum = _mm256_fmadd_ps(w, z, sum);
+        weightSum = _mm256_add_ps(weightSum, w);
+    }
+    const __m256 noneValid = _mm256_cmp_ps(weightSum, _mm256_setzero_ps(), _CMP_LE_OQ);
+    return _mm256_blendv_ps(_mm256_div_ps(sum, weightSum), _mm256_set1_ps(static_cast<float>(kHgtVoid)), noneValid);
+}
+
+SIM_TARGET_AVX2 static void cubicWeightsAvx2(__m256 t, __m256 (&w)[4])
+{
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f);
+    const __m256 t2 = _mm256_mul_ps(t, t);
+    w[0] = _mm256_mul_ps(_mm256_fmsub_ps(_mm256_fmadd_ps(_mm256_set1_ps(-0.5f), t, one), t, half), t);
+    w[1] = _mm256_fmadd_ps(_mm256_fmsub_ps(_mm256_set1_ps(1.5f), t, _mm256_set1_ps(2.5f)), t2, one);
+    w[2] = _mm256_mul_ps(_mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_set1_ps(-1.5f), t, _mm256_set1_ps(2.0f)), t, half), t);
+    w[3] = _mm256_mul_ps(_mm256_fmsub_ps(half, t, half), t2);
+}
+
+template <typename T>
+SIM_TARGET_AVX2 static __m256 bicubicAvx2(const GridView<T>& grid, const VoidMask* voids, __m256i last, __m256 col, __m256 row)
+{
+    __m256i x0, y0;
+    __m256 fx, fy;
+    splitCoordAvx2(col, grid.cols, x0, fx);
+    splitCoordAvx2(row, grid.rows, y0, fy);
+
+    __m256 wx[4], wy[4];
+    cubicWeightsAvx2(fx, wx);
+    cubicWeightsAvx2(fy, wy);
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lastCol = _mm256_set1_epi32(static_cast<int32_t>(grid.cols - 1));
+    const __m256i lastRow = _mm256_set1_epi32(static_cast<int32_t>(grid.rows - 1));
+    const __m256i stride = _mm256_set1_epi32(static_cast<int32_t>(grid.stride));
+    __m256i xs[4];
+    for (int i = 0; i < 4; i++) {
+        xs[i] = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(x0, _mm256_set1_epi32(i - 1)), zero), lastCol);
+    }
+
+    __m256 sum = _mm256_setzero_ps();
+    __m256 allValid = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int j = 0; j < 4; j++) {
+        const __m256i r = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(y0, _mm256_set1_epi32(j - 1)), zero), lastRow);
+        const __m256i rowStart = _mm256_mullo_epi32(r, stride);
+        __m256 rowSum = _mm256_setzero_ps();
+        for (int i = 0; i < 4; i++) {
+            const __m256i idx = _mm256_add_epi32(rowStart, xs[i]);
+            const __m256 z = gatherSamples(grid.data, idx, last);
+            allValid = _mm256_and_ps(allValid, validLanes(z, idx, voids));
+            rowSum = _mm256_fmadd_ps(wx[i], z, rowSum);
+        }
+        sum = _mm256_fmadd_ps(wy[j], rowSum, sum);
+    }
+    if (_mm256_movemask_ps(allValid) != 0xFF) {
+        sum = _mm256_blendv_ps(bilinearAvx2(grid, voids, last, col, row), sum, allValid);
+    }
+    return sum;
+}
+
+template <typename T>
+SIM_TARGET_AVX2 static size_t sampleAvx2(const GridView<T>& grid, const VoidMask* voids,
+    const float* cols, const float* rows, float* heights, size_t n, HeightSampler::Filter filter)
+{
+    const __m256i last = _mm256_set1_epi32(static_cast<int32_t>((grid.rows - 1) * grid.stride + grid.cols - 1));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 col = _mm256_loadu_ps(cols + i), row = _mm256_loadu_ps(rows + i);
+        const __m256 h = filter == HeightSampler::Filter::Bicubic ? bicubicAvx2(grid, voids, last, col, row)
+                                                                 : bilinearAvx2(grid, voids, last, col, row);
+        _mm256_storeu_ps(heights + i, h);
+    }
+    return i;
+}
+#endif
+
+void HeightSampler::sample(const float* cols, const float* rows, float* heights, size_t n, Filter filter) const
+{
+    size_t done = 0;
+#if SIM_X86
+    if (cpuHasAvx2()) done = grid_.visit([&](const auto& grid) { return sampleAvx2(grid, voids_, cols, rows, heights, n, filter); });
+#endif
+    sampleScalar(cols + done, rows + done, heights + done, n - done, filter);
+}
+
+template HeightSampler::HeightSampler(const GridView<float>&, const VoidMask*);
+template HeightSampler::HeightSampler(const GridView<int16_t>&, const VoidMask*);
+template HeightSampler::HeightSampler(const GridView<HgtSample>&, const VoidMask*);
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include "GridView.h"
+#include "HgtDecode.h"
+
+// Height queries at fractional grid coordinates over an elevation grid of
+// float, int16_t or HgtSample samples (e.g. a mapped SRTM tile, read in place).
+// Coordinates are in samples: 'col' 0..cols-1 west to east, 'row' 0..rows-1
+// north to south. Queries outside the grid are clamped to its border.
+//
+// A sample is void if it holds kHgtVoid or, when a VoidMask is given, its bit
+// (row*stride + col) is set. Bilinear skips void corners and renormalizes the
+// remaining weights; bicubic falls back to bilinear when any of its 16
+// samples is void. Queries with no valid sample around them return kHgtVoid.
+class HeightSampler
+{
+public:
+    enum class Filter { Bilinear, Bicubic }; // bicubic is Catmull-Rom
+
+    // Keeps references to 'grid' and 'voids'; both must outlive the sampler.
+    // T is float, int16_t or HgtSample.
+    template <typename T>
+    explicit HeightSampler(const GridView<T>& grid, const VoidMask* voids = nullptr);
+
+    // One query; the scalar reference for the batch kernels.
+    float sample(float col, float row, Filter filter = Filter::Bilinear) const;
+
+    // 'n' queries given as separate coordinate arrays. Dispatches at runtime
+    // to the AVX2 gather kernel when available (8 queries per step).
+    void sample(const float* cols, const float* rows, float* heights, size_t n, Filter filter = Filter::Bilinear) const;
+
+    // Same, always scalar.
+    void sampleScalar(const float* cols, const float* rows, float* heights, size_t n, Filter filter = Filter::Bilinear) const;
+
+private:
+    AnyGridView grid_;
+    const VoidMask* voids_;
+};
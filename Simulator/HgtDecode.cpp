@@ -0,0 +1,229 @@
+#include "HgtDecode.h"
+#include "../Utils/CpuFeatures.h"
+#include <algorithm>
+#include <bitset>
+#include <type_traits>
+
+void decodeHgtSamplesScalar(const uint8_t* src, float* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t u = (static_cast<uint16_t>(src[2 * i]) << 8) | static_cast<uint16_t>(src[2 * i + 1]);
+        dst[i] = static_cast<float>(static_cast<int16_t>(u));
+    }
+}
+
+void decodeHgtSamplesScalar(const uint8_t* src, int16_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t u = (static_cast<uint16_t>(src[2 * i]) << 8) | static_cast<uint16_t>(src[2 * i + 1]);
+        dst[i] = static_cast<int16_t>(u);
+    }
+}
+
+#if SIM_X86
+// 16 samples per iteration: swap the bytes of each int16 in both 128-bit
+// lanes, then sign-extend each half to int32 and convert to float.
+SIM_TARGET_AVX2 static void decodeHgtSamplesAvx2(const uint8_t* src, float* dst, size_t count)
+{
+    const __m256i swap = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        raw = _mm256_shuffle_epi8(raw, swap);
+        const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(raw));
+        const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(raw, 1));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(lo));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(hi));
+    }
+    decodeHgtSamplesScalar(src + 2 * i, dst + i, count - i);
+}
+
+SIM_TARGET_AVX2 static void decodeHgtSamplesAvx2(const uint8_t* src, int16_t* dst, size_t count)
+{
+    const __m256i swap = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(raw, swap));
+    }
+    decodeHgtSamplesScalar(src + 2 * i, dst + i, count - i);
+}
+
+// 8 samples per iteration with the same swap/widen sequence on 128-bit registers.
+SIM_TARGET_SSE41 static void decodeHgtSamplesSse41(const uint8_t* src, float* dst, size_t count)
+{
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        raw = _mm_shuffle_epi8(raw, swap);
+        const __m128i lo = _mm_cvtepi16_epi32(raw);
+        const __m128i hi = _mm_cvtepi16_epi32(_mm_srli_si128(raw, 8));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(lo));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(hi));
+    }
+    decodeHgtSamplesScalar(src + 2 * i, dst + i, count - i);
+}
+
+SIM_TARGET_SSE41 static void decodeHgtSamplesSse41(const uint8_t* src, int16_t* dst, size_t count)
+{
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(raw, swap));
+    }
+    decodeHgtSamplesScalar(src + 2 * i, dst + i, count - i);
+}
+#endif
+
+void decodeHgtSamples(const uint8_t* src, float* dst, size_t count)
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        decodeHgtSamplesAvx2(src, dst, count);
+        return;
+    }
+    if (cpuHasSse41()) {
+        decodeHgtSamplesSse41(src, dst, count);
+        return;
+    }
+#endif
+    decodeHgtSamplesScalar(src, dst, count);
+}
+
+void decodeHgtSamples(const uint8_t* src, int16_t* dst, size_t count)
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        decodeHgtSamplesAvx2(src, dst, count);
+        return;
+    }
+    if (cpuHasSse41()) {
+        decodeHgtSamplesSse41(src, dst, count);
+        return;
+    }
+#endif
+    decodeHgtSamplesScalar(src, dst, count);
+}
+
+// Scalar decode + statistics. 'first' is the mask index of src[0].
+template <typename T>
+static void decodeHgtStatsScalar(const uint8_t* src, T* dst, size_t count, HgtStats& stats, VoidMask* voids, size_t first)
+{
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t u = (static_cast<uint16_t>(src[2 * i]) << 8) | static_cast<uint16_t>(src[2 * i + 1]);
+        const int16_t v = static_cast<int16_t>(u);
+        dst[i] = static_cast<T>(v);
+
+        if (v == kHgtVoid) {
+            stats.voidCount++;
+            if (voids) voids->set(first + i);
+            continue;
+        }
+        if (v < stats.minValue) stats.minValue = v;
+        if (v > stats.maxValue) stats.maxValue = v;
+        stats.sum += v;
+        stats.validCount++;
+    }
+}
+
+#if SIM_X86
+// 16 samples per iteration. Voids are INT16_MIN, so they never raise the max;
+// for the min and the sum they are masked out. Partial sums are kept in int32
+// lanes and flushed to int64 before they can overflow.
+template <typename T>
+SIM_TARGET_AVX2 static void decodeHgtStatsAvx2(const uint8_t* src, T* dst, size_t count, HgtStats& stats, VoidMask* voids)
+{
+    const __m256i swap = _mm256_setr_epi8(
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+        1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i voidValue = _mm256_set1_epi16(kHgtVoid);
+    const __m256i maxValue = _mm256_set1_epi16(32767);
+    const __m256i ones = _mm256_set1_epi16(1);
+    // 16384 iterations add at most 2^14 * 2 * 32767 < 2^31 per lane.
+    const size_t flushEvery = 16384;
+
+    __m256i vmin = maxValue;
+    __m256i vmax = voidValue;
+    int64_t sum = 0;
+    size_t voidCount = 0;
+
+    size_t i = 0;
+    while (count - i >= 16) {
+        const size_t blockEnd = i + std::min((count - i) / 16, flushEvery) * 16;
+        __m256i vsum = _mm256_setzero_si256();
+        for (; i < blockEnd; i += 16) {
+            const __m256i x = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i)), swap);
+            if constexpr (std::is_same<T, float>::value) {
+                _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(x))));
+                _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1))));
+            } else {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), x);
+            }
+
+            const __m256i isVoid = _mm256_cmpeq_epi16(x, voidValue);
+            vmin = _mm256_min_epi16(vmin, _mm256_blendv_epi8(x, maxValue, isVoid));
+            vmax = _mm256_max_epi16(vmax, x);
+            vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(_mm256_andnot_si256(isVoid, x), ones));
+
+            const unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_packs_epi16(_mm256_castsi256_si128(isVoid), _mm256_extracti128_si256(isVoid, 1))));
+            if (bits) {
+                voidCount += std::bitset<16>(bits).count();
+                // 'i' is a multiple of 16, so the 16 bits never straddle a word.
+                if (voids) voids->words[i >> 6] |= static_cast<uint64_t>(bits) << (i & 63);
+            }
+        }
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), vsum);
+        for (const int32_t lane : lanes) sum += lane;
+    }
+
+    alignas(32) int16_t mins[16], maxs[16];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(mins), vmin);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(maxs), vmax);
+
+    HgtStats local;
+    local.minValue = *std::min_element(mins, mins + 16);
+    local.maxValue = *std::max_element(maxs, maxs + 16);
+    local.sum = sum;
+    local.voidCount = voidCount;
+    local.validCount = i - voidCount;
+
+    decodeHgtStatsScalar(src + 2 * i, dst + i, count - i, local, voids, i);
+    stats.merge(local);
+}
+#endif
+
+template <typename T>
+static void decodeHgtStats(const uint8_t* src, T* dst, size_t count, HgtStats& stats, VoidMask* voids)
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        decodeHgtStatsAvx2(src, dst, count, stats, voids);
+        return;
+    }
+#endif
+    HgtStats local;
+    decodeHgtStatsScalar(src, dst, count, local, voids, 0);
+    stats.merge(local);
+}
+
+void decodeHgtSamples(const uint8_t* src, float* dst, size_t count, HgtStats& stats, VoidMask* voids)
+{
+    decodeHgtStats(src, dst, count, stats, voids);
+}
+
+void decodeHgtSamples(const uint8_t* src, int16_t* dst, size_t count, HgtStats& stats, VoidMask* voids)
+{
+    decodeHgtStats(src, dst, count, stats, voids);
+}
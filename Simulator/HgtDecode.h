@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// SRTM marks missing samples ("voids") with the most negative int16.
+constexpr int16_t kHgtVoid = -32768;
+
+// Void-aware summary of decoded samples. Voids are counted but excluded from
+// min/max/mean; min > max means every sample was void.
+struct HgtStats {
+    int16_t minValue = 32767;
+    int16_t maxValue = -32768;
+    int64_t sum = 0;
+    size_t validCount = 0;
+    size_t voidCount = 0;
+
+    double mean() const { return validCount ? static_cast<double>(sum) / static_cast<double>(validCount) : 0.0; }
+
+    void merge(const HgtStats& other)
+    {
+        if (other.minValue < minValue) minValue = other.minValue;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+        sum += other.sum;
+        validCount += other.validCount;
+        voidCount += other.voidCount;
+    }
+};
+
+// One bit per sample, set where the sample is void.
+struct VoidMask {
+    std::vector<uint64_t> words;
+    size_t size = 0;
+
+    VoidMask() = default;
+    explicit VoidMask(size_t count) : words((count + 63) / 64), size(count) {}
+
+    bool test(size_t i) const { return ((words[i >> 6] >> (i & 63)) & 1) != 0; }
+    void set(size_t i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+};
+
+// Bulk conversion of raw HGT samples (signed 16-bit big-endian) to float.
+// 'src' holds 2*count bytes, 'dst' receives 'count' floats. Dispatches at
+// runtime to the widest kernel the CPU supports (AVX2, SSE4.1, scalar).
+void decodeHgtSamples(const uint8_t* src, float* dst, size_t count);
+
+// Byte-swap only, keeping the native int16 metres. Same dispatch as above.
+void decodeHgtSamples(const uint8_t* src, int16_t* dst, size_t count);
+
+// Scalar reference kernels. Always available; used for tails and as fallback.
+void decodeHgtSamplesScalar(const uint8_t* src, float* dst, size_t count);
+void decodeHgtSamplesScalar(const uint8_t* src, int16_t* dst, size_t count);
+
+// Decode as above and, in the same pass, accumulate void-aware statistics into
+// 'stats' and set bit i of 'voids' (if given, sized for 'count') for each void.
+void decodeHgtSamples(const uint8_t* src, float* dst, size_t count, HgtStats& stats, VoidMask* voids);
+void decodeHgtSamples(const uint8_t* src, int16_t* dst, size_t count, HgtStats& stats, VoidMask* voids);
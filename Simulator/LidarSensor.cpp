@@ -1 +1,624 @@
 #include "LidarSensor.h"
+#include "HgtDecode.h"
+#include "ScanPattern.h"
+#include "Trajectory.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+void Platform::toWorld(size_t n, float* dx, float* dy) const
+{
+    const float ch = std::cos(heading), sh = std::sin(heading);
+    for (size_t i = 0; i < n; i++) {
+        const float sx = dx[i], sy = dy[i];
+        dx[i] = ch * sx - sh * sy;
+        dy[i] = sh * sx + ch * sy;
+    }
+}
+
+template <typename T>
+LidarSensor::LidarSensor(const GridView<T>& grid, float cellWidth, float cellHeight, ThreadPool* pool)
+    : grid_(grid), cellWidth_(cellWidth), cellHeight_(cellHeight), mipmap_(grid, pool)
+{
+    if (!(cellWidth > 0.0f) || !(cellHeight > 0.0f)) throw std::invalid_argument("cell size must be positive");
+
+    const size_t top = mipmap_.levelCount() - 1;
+    if (top > 0) {
+        maxElevation_ = mipmap_.blockMax(top, 0, 0);
+    } else {
+        maxElevation_ = static_cast<float>(kHgtVoid);
+        for (size_t r = 0; r < 2; r++) {
+            for (size_t c = 0; c < 2; c++) maxElevation_ = std::max(maxElevation_, sampleValue(grid.at(r, c)));
+        }
+    }
+
+    for (size_t k = 0; k <= top; k++) {
+        levelRows_.push_back(static_cast<int32_t>(mipmap_.rows(k)));
+        levelCols_.push_back(static_cast<int32_t>(mipmap_.cols(k)));
+        levelOffset_.push_back(static_cast<int32_t>(k > 0 ? mipmap_.levelOffset(k) : 0));
+        levelBricksPerRow_.push_back(static_cast<int32_t>(k > 0 ? mipmap_.bricksPerRow(k) : 0));
+    }
+}
+
+// Ray parameter at which coordinate 'o + t*d' leaves [lo, hi]; infinite when
+// the ray runs parallel to it.
+static double slabExit(double o, double d, double lo, double hi)
+{
+    if (d > 0.0) return (hi - o) / d;
+    if (d < 0.0) return (lo - o) / d;
+    return std::numeric_limits<double>::infinity();
+}
+
+// Smallest root in [0, sMax] of f(s) = c + b*s + a*s^2, given f(0) > 0.
+static bool firstRoot(double a, double b, double c, double sMax, double& s)
+{
+    double roots[2];
+    int n = 0;
+    if (std::fabs(a) < 1e-12) {
+        if (b >= 0.0) return false;
+        roots[n++] = -c / b;
+    } else {
+        const double disc = b * b - 4.0 * a * c;
+        if (disc < 0.0) return false;
+        // Numerically stable pair of roots.
+        const double q = -0.5 * (b + std::copysign(std::sqrt(disc), b));
+        roots[n++] = q / a;
+        if (q != 0.0) roots[n++] = c / q;
+    }
+    s = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < n; i++) {
+        if (roots[i] >= 0.0 && roots[i] <= sMax) s = std::min(s, roots[i]);
+    }
+    return s <= sMax;
+}
+
+bool LidarSensor::setupRay(const Ray& ray, GridRay& g) const
+{
+    g.len = std::sqrt(double(ray.dx) * ray.dx + double(ray.dy) * ray.dy + double(ray.dz) * ray.dz);
+    if (g.len == 0.0) return false;
+
+    const double lastRow = static_cast<double>(grid_.rows - 1), lastCol = static_cast<double>(grid_.cols - 1);
+    g.o[0] = ray.ox / cellWidth_;
+    g.o[1] = lastRow - ray.oy / cellHeight_;
+    g.o[2] = ray.oz;
+    g.d[0] = ray.dx / g.len / cellWidth_;
+    g.d[1] = -ray.dy / g.len / cellHeight_;
+    g.d[2] = ray.dz / g.len;
+
+    // Clip to the grid footprint and to the part of the ray below the highest sample.
+    g.tNear = 0.0;
+    g.tFar = std::numeric_limits<double>::infinity();
+    const double bounds[2] = { lastCol, lastRow };
+    for (int axis = 0; axis < 2; axis++) {
+        if (g.d[axis] == 0.0) {
+            if (g.o[axis] < 0.0 || g.o[axis] > bounds[axis]) return false;
+            continue;
+        }
+        double t0 = (0.0 - g.o[axis]) / g.d[axis], t1 = (bounds[axis] - g.o[axis]) / g.d[axis];
+        if (t0 > t1) std::swap(t0, t1);
+        g.tNear = std::max(g.tNear, t0);
+        g.tFar = std::min(g.tFar, t1);
+    }
+    const double top = maxElevation_;
+    if (g.o[2] > top) {
+        if (g.d[2] >= 0.0) return false;
+        g.tNear = std::max(g.tNear, (top - g.o[2]) / g.d[2]);
+    } else if (g.d[2] > 0.0) {
+        g.tFar = std::min(g.tFar, (top - g.o[2]) / g.d[2]);
+    }
+    return g.tNear <= g.tFar;
+}
+
+// Intersection with the bilinear patch of cell (r, c) for t in [t, tExit].
+bool LidarSensor::hitCell(size_t r, size_t c, double t, double tExit, const GridRay& g, double& tHit) const
+{
+    const float voidValue = static_cast<float>(kHgtVoid);
+    float z[4];
+    grid_.visit([&](const auto& grid) {
+        z[0] = sampleValue(grid.at(r, c));
+        z[1] = sampleValue(grid.at(r, c + 1));
+        z[2] = sampleValue(grid.at(r + 1, c));
+        z[3] = sampleValue(grid.at(r + 1, c + 1));
+    });
+    if (z[0] == voidValue || z[1] == voidValue || z[2] == voidValue || z[3] == voidValue) return false;
+    const double z00 = z[0], z01 = z[1], z10 = z[2], z11 = z[3];
+
+    const double zEnter = g.o[2] + t * g.d[2], zExit = g.o[2] + tExit * g.d[2];
+    if (std::min(zEnter, zExit) > std::max(std::max(z00, z01), std::max(z10, z11))) return false;
+
+    // H(a, b) = z00 + B a + C b + D a b over the cell's local coordinates.
+    const double B = z01 - z00, C = z10 - z00, D = z00 - z01 - z10 + z11;
+    const double a0 = g.o[0] + t * g.d[0] - static_cast<double>(c);
+    const double b0 = g.o[1] + t * g.d[1] - static_cast<double>(r);
+    const double h0 = z00 + B * a0 + C * b0 + D * a0 * b0;
+    const double h1 = B * g.d[0] + C * g.d[1] + D * (a0 * g.d[1] + b0 * g.d[0]);
+    const double h2 = D * g.d[0] * g.d[1];
+
+    // f(s) = ray height - surface height, s measured from t.
+    const double f0 = zEnter - h0;
+    if (f0 <= 0.0) {
+        tHit = t;
+        return true;
+    }
+    double s;
+    if (!firstRoot(-h2, g.d[2] - h1, f0, tExit - t, s)) return false;
+    tHit = t + s;
+    return true;
+}
+
+// Walk the mipmap from parameter 't' at 'level': descend while the ray may
+// touch a block, skip it when it passes above, and climb one level after
+// every skip.
+bool LidarSensor::traverse(const GridRay& g, double t, size_t level, double& tHit, size_t& cellRow, size_t& cellCol) const
+{
+    const double lastRow = static_cast<double>(grid_.rows - 1), lastCol = static_cast<double>(grid_.cols - 1);
+    const size_t topLevel = mipmap_.levelCount() - 1;
+    while (t <= g.tFar) {
+        const double size = static_cast<double>(size_t(1) << level);
+        const int64_t blockRows = levelRows_[level], blockCols = levelCols_[level];
+        int64_t c = std::min(std::max(static_cast<int64_t>(std::floor((g.o[0] + t * g.d[0]) / size)), int64_t(0)), blockCols - 1);
+        int64_t r = std::min(std::max(static_cast<int64_t>(std::floor((g.o[1] + t * g.d[1]) / size)), int64_t(0)), blockRows - 1);
+
+        // On a block boundary, rounding can put t in the block just left;
+        // step on in the direction of travel until the exit lies ahead.
+        double tu = slabExit(g.o[0], g.d[0], c * size, std::min((c + 1) * size, lastCol));
+        while (tu <= t) {
+            c += g.d[0] > 0.0 ? 1 : -1;
+            if (c < 0 || c >= blockCols) return false;
+            tu = slabExit(g.o[0], g.d[0], c * size, std::min((c + 1) * size, lastCol));
+        }
+        double tv = slabExit(g.o[1], g.d[1], r * size, std::min((r + 1) * size, lastRow));
+        while (tv <= t) {
+            r += g.d[1] > 0.0 ? 1 : -1;
+            if (r < 0 || r >= blockRows) return false;
+            tv = slabExit(g.o[1], g.d[1], r * size, std::min((r + 1) * size, lastRow));
+        }
+        const double tExit = std::min(std::min(tu, tv), g.tFar);
+
+        if (level == 0) {
+            if (hitCell(static_cast<size_t>(r), static_cast<size_t>(c), t, tExit, g, tHit)) {
+                cellRow = static_cast<size_t>(r);
+                cellCol = static_cast<size_t>(c);
+                return true;
+            }
+        } else {
+            const double zLow = g.o[2] + std::min(t * g.d[2], tExit * g.d[2]);
+            if (!mipmap_.below(level, static_cast<size_t>(r), static_cast<size_t>(c), static_cast<float>(zLow))) {
+                level--;
+                continue;
+            }
+        }
+        if (tExit >= g.tFar) break;
+        t = tExit;
+        level = std::min(level + 1, topLevel);
+    }
+    return false;
+}
+
+LidarReturn LidarSensor::makeReturn(const Ray& ray, const GridRay& g, double tHit, size_t r, size_t c) const
+{
+    LidarReturn result;
+    result.hit = true;
+    result.range = static_cast<float>(tHit);
+    result.x = static_cast<float>(ray.ox + ray.dx / g.len * tHit);
+    result.y = static_cast<float>(ray.oy + ray.dy / g.len * tHit);
+    result.z = static_cast<float>(ray.oz + ray.dz / g.len * tHit);
+    result.cell = static_cast<uint32_t>(r * grid_.cols + c);
+    return result;
+}
+
+LidarReturn LidarSensor::castRay(const Ray& ray) const
+{
+    GridRay g;
+    double tHit;
+    size_t r, c;
+    if (setupRay(ray, g) && traverse(g, g.tNear, mipmap_.levelCount() - 1, tHit, r, c)) {
+        return makeReturn(ray, g, tHit, r, c);
+    }
+    return LidarReturn();
+}
+
+void LidarSensor::castRays(const Ray* rays, LidarReturn* returns, size_t n) const
+{
+    for (size_t i = 0; i < n; i++) returns[i] = castRay(rays[i]);
+}
+
+#if SIM_X86
+// Lane mask (all bits set) from the low 8 bits of 'bits'.
+SIM_TARGET_AVX2 static __m256i laneMask(int bits)
+{
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), lanes), lanes);
+}
+
+SIM_TARGET_AVX2 static int laneBits(__m256i mask)
+{
+    return _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+}
+
+// Spread the low three bits of each lane to the even bit positions.
+SIM_TARGET_AVX2 static __m256i spread(__m256i x)
+{
+    return _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(x, _mm256_set1_epi32(1)),
+        _mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(2)), 1)),
+        _mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(4)), 2));
+}
+
+// Lower block index along one axis and the parameter where the ray leaves
+// that block, stepping once past a boundary that rounding left behind.
+// Lanes that step off the grid are cleared from 'live'.
+SIM_TARGET_AVX2 static __m256 blockExit(__m256 o, __m256 d, __m256 invD, __m256i step, __m256 t, __m256 size, __m256 invSize,
+    __m256i blocks, __m256 last, __m256i& index, int& live)
+{
+    const __m256 pos = _mm256_fmadd_ps(t, d, o);
+    index = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(pos, invSize)));
+    index = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), _mm256_sub_epi32(blocks, _mm256_set1_epi32(1)));
+
+    const __m256 forward = _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GT_OQ);
+    const __m256 parallel = _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_EQ_OQ);
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 exit = inf;
+    for (int pass = 0; pass < 2; pass++) {
+        const __m256 lo = _mm256_mul_ps(_mm256_cvtepi32_ps(index), size);
+        const __m256 hi = _mm256_min_ps(_mm256_add_ps(lo, size), last);
+        exit = _mm256_mul_ps(_mm256_sub_ps(_mm256_blendv_ps(lo, hi, forward), o), invD);
+        exit = _mm256_blendv_ps(exit, inf, parallel);
+        if (pass == 1) break;
+        const __m256i behind = _mm256_castps_si256(_mm256_cmp_ps(exit, t, _CMP_LE_OQ));
+        if (_mm256_testz_si256(behind, behind)) break;
+        index = _mm256_add_epi32(index, _mm256_and_si256(behind, step));
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), index),
+            _mm256_cmpgt_epi32(index, _mm256_sub_epi32(blocks, _mm256_set1_epi32(1))));
+        live &= ~laneBits(outside);
+        index = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), _mm256_sub_epi32(blocks, _mm256_set1_epi32(1)));
+    }
+    return exit;
+}
+
+void LidarSensor::castPacketAvx2(const RayPacket& packet, LidarReturn* returns) const
+{
+    GridRay g[8];
+    alignas(32) float o[3][8], d[3][8], invD[2][8], tNear[8], tFar[8];
+    int live = 0;
+    for (int i = 0; i < 8; i++) {
+        returns[i] = LidarReturn();
+        const bool usable = setupRay(packet.ray(i), g[i]);
+        for (int a = 0; a < 3; a++) {
+            o[a][i] = usable ? static_cast<float>(g[i].o[a]) : 0.0f;
+            d[a][i] = usable ? static_cast<float>(g[i].d[a]) : 0.0f;
+        }
+        for (int a = 0; a < 2; a++) invD[a][i] = d[a][i] != 0.0f ? 1.0f / d[a][i] : 0.0f;
+        tNear[i] = usable ? static_cast<float>(g[i].tNear) : 0.0f;
+        tFar[i] = usable ? static_cast<float>(std::min(g[i].tFar, 1e30)) : 0.0f;
+        if (usable) live |= 1 << i;
+    }
+
+    const __m256 o0 = _mm256_load_ps(o[0]), o1 = _mm256_load_ps(o[1]), o2 = _mm256_load_ps(o[2]);
+    const __m256 d0 = _mm256_load_ps(d[0]), d1 = _mm256_load_ps(d[1]), d2 = _mm256_load_ps(d[2]);
+    const __m256 invD0 = _mm256_load_ps(invD[0]), invD1 = _mm256_load_ps(invD[1]);
+    const __m256 vFar = _mm256_load_ps(tFar);
+    const __m256i one = _mm256_set1_epi32(1), minusOne = _mm256_set1_epi32(-1);
+    const __m256i step0 = _mm256_blendv_epi8(minusOne, one, _mm256_castps_si256(_mm256_cmp_ps(d0, _mm256_setzero_ps(), _CMP_GT_OQ)));
+    const __m256i step1 = _mm256_blendv_epi8(minusOne, one, _mm256_castps_si256(_mm256_cmp_ps(d1, _mm256_setzero_ps(), _CMP_GT_OQ)));
+    const __m256 lastCol = _mm256_set1_ps(static_cast<float>(grid_.cols - 1));
+    const __m256 lastRow = _mm256_set1_ps(static_cast<float>(grid_.rows - 1));
+    const int32_t topLevel = static_cast<int32_t>(mipmap_.levelCount() - 1);
+    const __m256i vTop = _mm256_set1_epi32(topLevel);
+    const int* mipmap = reinterpret_cast<const int*>(mipmap_.data());
+
+    __m256 t = _mm256_load_ps(tNear);
+    __m256i level = vTop;
+
+    // Lock-step walk while enough lanes are live; each step is bounded so a
+    // lane stuck on rounding cannot stall the packet.
+    for (int iteration = 0; std::bitset<8>(static_cast<unsigned>(live)).count() > 2 && iteration < 64 * (topLevel + 1); iteration++) {
+        // Block size 2^level and its exact reciprocal, built from the exponent.
+        const __m256 size = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(level, _mm256_set1_epi32(127)), 23));
+        const __m256 invSize = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(127), level), 23));
+        const __m256i blockRows = _mm256_i32gather_epi32(levelRows_.data(), level, 4);
+        const __m256i blockCols = _mm256_i32gather_epi32(levelCols_.data(), level, 4);
+
+        __m256i c, r;
+        const __m256 tu = blockExit(o0, d0, invD0, step0, t, size, invSize, blockCols, lastCol, c, live);
+        const __m256 tv = blockExit(o1, d1, invD1, step1, t, size, invSize, blockRows, lastRow, r, live);
+        const __m256 tExit = _mm256_min_ps(_mm256_min_ps(tu, tv), vFar);
+
+        const int leaf = live & laneBits(_mm256_cmpeq_epi32(level, _mm256_setzero_si256()));
+        const int inner = live & ~leaf;
+        int advance = 0;
+
+        if (inner) {
+            // Morton index inside the brick: column bits even, row bits odd.
+            const __m256i seven = _mm256_set1_epi32(7);
+            const __m256i bricksPerRow = _mm256_i32gather_epi32(levelBricksPerRow_.data(), level, 4);
+            const __m256i offset = _mm256_i32gather_epi32(levelOffset_.data(), level, 4);
+            const __m256i brick = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(r, 3), bricksPerRow), _mm256_srli_epi32(c, 3));
+            const __m256i inBrick = _mm256_or_si256(spread(_mm256_and_si256(c, seven)), _mm256_slli_epi32(spread(_mm256_and_si256(r, seven)), 1));
+            const __m256i index = _mm256_add_epi32(offset, _mm256_add_epi32(_mm256_slli_epi32(brick, 6), inBrick));
+            // 32-bit gather at int16 addresses; the low half is the block max.
+            const __m256i raw = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), mipmap, index, laneMask(inner), 2);
+            const __m256 blockMax = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(raw, 16), 16));
+
+            const __m256 zLow = _mm256_add_ps(o2, _mm256_min_ps(_mm256_mul_ps(t, d2), _mm256_mul_ps(tExit, d2)));
+            const int below = laneBits(_mm256_castps_si256(_mm256_cmp_ps(blockMax, zLow, _CMP_LT_OQ)));
+            advance |= inner & below;
+            level = _mm256_sub_epi32(level, _mm256_and_si256(laneMask(inner & ~below), one));
+        }
+
+        if (leaf) {
+            alignas(32) float ts[8], exits[8];
+            alignas(32) int32_t rs[8], cs[8];
+            _mm256_store_ps(ts, t);
+            _mm256_store_ps(exits, tExit);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(rs), r);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(cs), c);
+            for (int bits = leaf; bits; bits &= bits - 1) {
+                const int i = static_cast<int>(std::bitset<8>(static_cast<unsigned>((bits & -bits) - 1)).count());
+                double tHit;
+                if (hitCell(static_cast<size_t>(rs[i]), static_cast<size_t>(cs[i]), ts[i], exits[i], g[i], tHit)) {
+                    returns[i] = makeReturn(packet.ray(i), g[i], tHit, static_cast<size_t>(rs[i]), static_cast<size_t>(cs[i]));
+                    live &= ~(1 << i);
+                } else {
+                    advance |= 1 << i;
+                }
+            }
+        }
+
+        advance &= live;
+        live &= ~(advance & laneBits(_mm256_castps_si256(_mm256_cmp_ps(tExit, vFar, _CMP_GE_OQ))));
+        advance &= live;
+        const __m256i move = laneMask(advance);
+        t = _mm256_blendv_ps(t, tExit, _mm256_castsi256_ps(move));
+        level = _mm256_blendv_epi8(level, _mm256_min_epi32(_mm256_add_epi32(level, one), vTop), move);
+    }
+
+    // The packet has diverged: finish the remaining rays one by one from where they are.
+    if (live) {
+        alignas(32) float ts[8];
+        alignas(32) int32_t levels[8];
+        _mm256_store_ps(ts, t);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(levels), level);
+        for (int i = 0; i < 8; i++) {
+            if (!(live & (1 << i))) continue;
+            double tHit;
+            size_t r, c;
+            if (traverse(g[i], ts[i], static_cast<size_t>(levels[i]), tHit, r, c)) {
+                returns[i] = makeReturn(packet.ray(i), g[i], tHit, r, c);
+            }
+        }
+    }
+}
+#endif
+
+void LidarSensor::castPacket(const RayPacket& packet, LidarReturn* returns) const
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        castPacketAvx2(packet, returns);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < 8; i++) returns[i] = castRay(packet.ray(i));
+}
+
+void LidarSensor::castPackets(const RayPacket* packets, size_t count, LidarReturn* returns) const
+{
+    for (size_t p = 0; p < count; p++) castPacket(packets[p], returns + 8 * p);
+}
+
+// Unit-disk offsets of the sub-rays: the R2 sequence (Roberts 2018) mapped
+// to the disk with an area-preserving polar map. Sample 0 is the beam axis.
+static const std::vector<float>& footprintOffsets()
+{
+    static const std::vector<float> offsets = [] {
+        std::vector<float> xy(2 * kMaxBeamSamples);
+        const double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+        for (size_t k = 0; k < kMaxBeamSamples; k++) {
+            const double u = std::fmod(k * a1, 1.0), v = std::fmod(k * a2, 1.0);
+            const double radius = std::sqrt(u), angle = 2.0 * 3.14159265358979323846 * v;
+            xy[2 * k] = static_cast<float>(radius * std::cos(angle));
+            xy[2 * k + 1] = static_cast<float>(radius * std::sin(angle));
+        }
+        return xy;
+    }();
+    return offsets;
+}
+
+BeamReturns LidarSensor::castBeam(const Ray& ray, const BeamModel& beam) const
+{
+    if (!(beam.divergence >= 0.0f) || !(beam.separation > 0.0f)) throw std::invalid_argument("invalid beam divergence or separation");
+    if (beam.minSamples == 0 || beam.maxSamples < beam.minSamples || beam.maxSamples > kMaxBeamSamples) {
+        throw std::invalid_argument("beam sample counts must satisfy 1 <= min <= max <= kMaxBeamSamples");
+    }
+    BeamReturns result;
+    const float len = std::sqrt(ray.dx * ray.dx + ray.dy * ray.dy + ray.dz * ray.dz);
+    if (len == 0.0f) return result;
+
+    // Basis of the footprint plane, perpendicular to the beam axis.
+    const float d[3] = { ray.dx / len, ray.dy / len, ray.dz / len };
+    const float helper[3] = { std::fabs(d[2]) < 0.9f ? 0.0f : 1.0f, 0.0f, std::fabs(d[2]) < 0.9f ? 1.0f : 0.0f };
+    float e1[3] = { d[1] * helper[2] - d[2] * helper[1], d[2] * helper[0] - d[0] * helper[2], d[0] * helper[1] - d[1] * helper[0] };
+    const float e1Len = std::sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+    for (float& e : e1) e /= e1Len;
+    const float e2[3] = { d[1] * e1[2] - d[2] * e1[1], d[2] * e1[0] - d[0] * e1[2], d[0] * e1[1] - d[1] * e1[0] };
+    const float radius = std::tan(0.5f * beam.divergence);
+    const std::vector<float>& offsets = footprintOffsets();
+
+    LidarReturn hits[kMaxBeamSamples];
+    RayPacket packet;
+    LidarReturn lanes[8];
+    const auto castUpTo = [&](size_t target) {
+        while (result.samples < target) {
+            const size_t n = std::min<size_t>(8, target - result.samples);
+            for (size_t lane = 0; lane < 8; lane++) {
+                const size_t k = result.samples + std::min(lane, n - 1);
+                const float a = radius * offsets[2 * k], b = radius * offsets[2 * k + 1];
+                packet.ox[lane] = ray.ox;
+                packet.oy[lane] = ray.oy;
+                packet.oz[lane] = ray.oz;
+                packet.dx[lane] = d[0] + a * e1[0] + b * e2[0];
+                packet.dy[lane] = d[1] + a * e1[1] + b * e2[1];
+                packet.dz[lane] = d[2] + a * e1[2] + b * e2[2];
+            }
+            castPacket(packet, lanes);
+            std::copy(lanes, lanes + n, hits + result.samples);
+            result.samples += n;
+        }
+    };
+
+    // Refine only where the first samples disagree.
+    castUpTo(beam.minSamples);
+    size_t hitCount = 0;
+    float nearest = std::numeric_limits<float>::infinity(), farthest = -nearest;
+    for (size_t k = 0; k < result.samples; k++) {
+        if (!hits[k].hit) continue;
+        hitCount++;
+        nearest = std::min(nearest, hits[k].range);
+        farthest = std::max(farthest, hits[k].range);
+    }
+    if ((hitCount > 0 && hitCount < result.samples) || farthest - nearest > beam.separation) castUpTo(beam.maxSamples);
+
+    // Cluster the hits by range: a gap wider than the separation starts a
+    // new return.
+    size_t order[kMaxBeamSamples], hitTotal = 0;
+    for (size_t k = 0; k < result.samples; k++) {
+        if (hits[k].hit) order[hitTotal++] = k;
+    }
+    if (hitTotal == 0) return result;
+    std::sort(order, order + hitTotal, [&hits](size_t a, size_t b) { return hits[a].range < hits[b].range; });
+
+    struct Cluster {
+        size_t first, count;
+        double range, x, y, z;
+    };
+    Cluster clusters[kMaxBeamSamples];
+    size_t clusterCount = 0;
+    for (size_t i = 0; i < hitTotal; i++) {
+        const LidarReturn& h = hits[order[i]];
+        if (clusterCount == 0 || h.range - hits[order[i - 1]].range > beam.separation) {
+            clusters[clusterCount++] = { order[i], 0, 0.0, 0.0, 0.0, 0.0 };
+        }
+        Cluster& c = clusters[clusterCount - 1];
+        c.count++;
+        c.range += h.range;
+        c.x += h.x;
+        c.y += h.y;
+        c.z += h.z;
+    }
+    // Merge the closest neighbours until the sensor can report them all.
+    while (clusterCount > kMaxBeamReturns) {
+        size_t best = 0;
+        double bestGap = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i + 1 < clusterCount; i++) {
+            const double gap = clusters[i + 1].range / clusters[i + 1].count - clusters[i].range / clusters[i].count;
+            if (gap < bestGap) {
+                bestGap = gap;
+                best = i;
+            }
+        }
+        Cluster& into = clusters[best];
+        const Cluster& from = clusters[best + 1];
+        into.count += from.count;
+        into.range += from.range;
+        into.x += from.x;
+        into.y += from.y;
+        into.z += from.z;
+        std::copy(clusters + best + 2, clusters + clusterCount, clusters + best + 1);
+        clusterCount--;
+    }
+
+    result.count = clusterCount;
+    for (size_t i = 0; i < clusterCount; i++) {
+        const Cluster& c = clusters[i];
+        const double n = static_cast<double>(c.count);
+        LidarReturn& out = result.returns[i];
+        out.hit = true;
+        out.range = static_cast<float>(c.range / n);
+        out.x = static_cast<float>(c.x / n);
+        out.y = static_cast<float>(c.y / n);
+        out.z = static_cast<float>(c.z / n);
+        out.cell = hits[c.first].cell;
+        result.weight[i] = static_cast<float>(n / result.samples);
+    }
+    return result;
+}
+
+void LidarSensor::castBeams(const Ray* rays, size_t n, const BeamModel& beam, BeamReturns* returns) const
+{
+    for (size_t i = 0; i < n; i++) returns[i] = castBeam(rays[i], beam);
+}
+
+template <class Pattern>
+void LidarSensor::scan(const Pattern& pattern, const Platform& platform, uint64_t first, size_t count, LidarReturn* returns) const
+{
+    const size_t batch = 4096;
+    std::vector<float> sx(batch), sy(batch), sz(batch);
+    RayPacket packet;
+    LidarReturn tail[8];
+    for (size_t done = 0; done < count; done += batch) {
+        const size_t n = std::min(batch, count - done);
+        pattern.generate(first + done, n, sx.data(), sy.data(), sz.data());
+        platform.toWorld(n, sx.data(), sy.data());
+        for (size_t i = 0; i < n; i += 8) {
+            // A short last packet repeats its final pulse in the spare lanes.
+            for (size_t lane = 0; lane < 8; lane++) {
+                const size_t k = std::min(i + lane, n - 1);
+                platform.origin(done + k, packet.ox[lane], packet.oy[lane], packet.oz[lane]);
+                packet.dx[lane] = sx[k];
+                packet.dy[lane] = sy[k];
+                packet.dz[lane] = sz[k];
+            }
+            if (i + 8 <= n) {
+                castPacket(packet, returns + done + i);
+            } else {
+                castPacket(packet, tail);
+                std::copy(tail, tail + (n - i), returns + done + i);
+            }
+        }
+    }
+}
+
+template <class Pattern>
+void LidarSensor::scan(const Pattern& pattern, const PoseBatch& poses, uint64_t first, LidarReturn* returns) const
+{
+    const size_t batch = 4096, count = poses.size();
+    std::vector<float> sx(batch), sy(batch), sz(batch);
+    RayPacket packet;
+    LidarReturn tail[8];
+    for (size_t done = 0; done < count; done += batch) {
+        const size_t n = std::min(batch, count - done);
+        pattern.generate(first + done, n, sx.data(), sy.data(), sz.data());
+        for (size_t i = 0; i < n; i += 8) {
+            for (size_t lane = 0; lane < 8; lane++) {
+                const size_t k = std::min(i + lane, n - 1), p = done + k;
+                packet.ox[lane] = poses.tx[p];
+                packet.oy[lane] = poses.ty[p];
+                packet.oz[lane] = poses.tz[p];
+                packet.dx[lane] = poses.r[0][p] * sx[k] + poses.r[1][p] * sy[k] + poses.r[2][p] * sz[k];
+                packet.dy[lane] = poses.r[3][p] * sx[k] + poses.r[4][p] * sy[k] + poses.r[5][p] * sz[k];
+                packet.dz[lane] = poses.r[6][p] * sx[k] + poses.r[7][p] * sy[k] + poses.r[8][p] * sz[k];
+            }
+            if (i + 8 <= n) {
+                castPacket(packet, returns + done + i);
+            } else {
+                castPacket(packet, tail);
+                std::copy(tail, tail + (n - i), returns + done + i);
+            }
+        }
+    }
+}
+
+template void LidarSensor::scan(const ZigZagPattern&, const Platform&, uint64_t, size_t, LidarReturn*) const;
+template void LidarSensor::scan(const PolygonPattern&, const Platform&, uint64_t, size_t, LidarReturn*) const;
+template void LidarSensor::scan(const PalmerPattern&, const Platform&, uint64_t, size_t, LidarReturn*) const;
+template void LidarSensor::scan(const MultiBeamPattern&, const Platform&, uint64_t, size_t, LidarReturn*) const;
+template void LidarSensor::scan(const ZigZagPattern&, const PoseBatch&, uint64_t, LidarReturn*) const;
+template void LidarSensor::scan(const PolygonPattern&, const PoseBatch&, uint64_t, LidarReturn*) const;
+template void LidarSensor::scan(const PalmerPattern&, const PoseBatch&, uint64_t, LidarReturn*) const;
+template void LidarSensor::scan(const MultiBeamPattern&, const PoseBatch&, uint64_t, LidarReturn*) const;
+
+template LidarSensor::LidarSensor(const GridView<float>&, float, float, ThreadPool*);
+template LidarSensor::LidarSensor(const GridView<int16_t>&, float, float, ThreadPool*);
+template LidarSensor::LidarSensor(const GridView<HgtSample>&, float, float, ThreadPool*);
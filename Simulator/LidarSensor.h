@@ -1,5 +1,154 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GridView.h"
+#include "MaxMipmap.h"
+#include "../Utils/CpuFeatures.h"
+#include "../Utils/ThreadPool.h"
+
+// World frame of a LidarSensor: x east and y north in metres from the
+// south-west sample of the grid, z up in elevation units (metres). Sample
+// (row, col) of the grid sits at x = col * cellWidth,
+// y = (rows - 1 - row) * cellHeight.
+struct Ray {
+    float ox, oy, oz; // origin
+    float dx, dy, dz; // direction, need not be normalized
+};
+
+// 8 rays in structure-of-arrays form, for packet casting.
+struct alignas(32) RayPacket {
+    float ox[8], oy[8], oz[8];
+    float dx[8], dy[8], dz[8];
+
+    Ray ray(size_t i) const { return Ray{ ox[i], oy[i], oz[i], dx[i], dy[i], dz[i] }; }
+};
+
+struct PoseBatch;
+
+// Sensor position at the first pulse of a scan and its motion per pulse.
+// 'heading' turns the sensor frame (x forward, y left, z up; see
+// ScanPattern.h) counter-clockwise from east about the vertical.
+struct Platform {
+    float x, y, z;
+    float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+    float heading = 0.0f; // radians
+
+    // Ray origin of the k-th pulse from this pose.
+    void origin(size_t k, float& ox, float& oy, float& oz) const
+    {
+        const float pulse = static_cast<float>(k);
+        ox = x + vx * pulse;
+        oy = y + vy * pulse;
+        oz = z + vz * pulse;
+    }
+
+    // Turn 'n' pulse directions from the sensor frame to the world, in place
+    // (z is unchanged by the heading).
+    void toWorld(size_t n, float* dx, float* dy) const;
+};
+
+struct LidarReturn {
+    bool hit = false;
+    float range = 0.0f;          // metres from the ray origin
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    uint32_t cell = 0;           // flat index (row * cols + col) of the hit cell's north-west sample
+};
+
+// Beam footprint model for castBeam(). Sub-rays spread over a cone of the
+// full divergence angle; hits closer in range than 'separation' make one
+// return. Every pulse casts minSamples sub-rays; only when those disagree
+// (some miss, or their ranges span more than one return) is the footprint
+// refined up to maxSamples.
+struct BeamModel {
+    float divergence = 0.0005f; // full angle, radians
+    float separation = 1.5f;    // metres; about the range resolution of a 10 ns pulse
+    size_t minSamples = 8;
+    size_t maxSamples = 32;     // at most kMaxBeamSamples
+};
+
+static constexpr size_t kMaxBeamSamples = 64;
+static constexpr size_t kMaxBeamReturns = 5;
+
+// Discrete returns of one pulse, first to last.
+struct BeamReturns {
+    size_t count = 0;
+    LidarReturn returns[kMaxBeamReturns];
+    float weight[kMaxBeamReturns] = {}; // share of the sub-rays behind each return
+    size_t samples = 0;                 // sub-rays cast
+};
+
+// Casts rays against the terrain surface of a DEM: each grid cell is the
+// bilinear patch through its four corner samples. Rays walk a MaxMipmap
+// top-down, skipping every block they pass above, and only solve the patch
+// equation (a quadratic along the ray) in cells they may actually hit.
+// Cells with a void corner return nothing, like water or radar shadow.
 class LidarSensor
 {
-};
+public:
+    // Keeps a reference to 'grid', which must outlive the sensor. T is float,
+    // int16_t or HgtSample, so a mapped tile is cast against in place. The
+    // mipmap is built on 'pool' if given.
+    template <typename T>
+    LidarSensor(const GridView<T>& grid, float cellWidth, float cellHeight, ThreadPool* pool = nullptr);
+
+    // First intersection of 'ray' with the terrain (t >= 0).
+    LidarReturn castRay(const Ray& ray) const;
+
+    void castRays(const Ray* rays, LidarReturn* returns, size_t n) const;
+
+    // Packets of 8 coherent rays (e.g. neighbouring pulses of a scan line),
+    // 8 returns per packet. With AVX2 the rays walk the mipmap in lock-step,
+    // one lane each; lanes that finish drop out, and once the packet has
+    // diverged to a couple of live rays they continue one by one. Without
+    // AVX2 every ray is cast on its own. Results match castRay().
+    void castPacket(const RayPacket& packet, LidarReturn* returns) const;
+    void castPackets(const RayPacket* packets, size_t count, LidarReturn* returns) const;
 
+    // Returns of a pulse with a finite footprint around 'ray', from a
+    // low-discrepancy set of sub-rays (every prefix covers the footprint
+    // evenly, so refining keeps the first samples). Hits are clustered by
+    // range; the mean range and position of each cluster make one return.
+    // Beyond kMaxBeamReturns clusters the closest neighbours are merged.
+    BeamReturns castBeam(const Ray& ray, const BeamModel& beam) const;
+    void castBeams(const Ray* rays, size_t n, const BeamModel& beam, BeamReturns* returns) const;
+
+    // Fires pulses first .. first+count-1 of 'pattern' from 'platform',
+    // one return per pulse. Directions are generated a batch at a time and
+    // cast as packets. Instantiated for the patterns in ScanPattern.h.
+    template <class Pattern>
+    void scan(const Pattern& pattern, const Platform& platform, uint64_t first, size_t count, LidarReturn* returns) const;
+
+    // Same, with the sensor-to-world pose of every pulse given, e.g. from
+    // Trajectory::interpolate(); fires poses.size() pulses.
+    template <class Pattern>
+    void scan(const Pattern& pattern, const PoseBatch& poses, uint64_t first, LidarReturn* returns) const;
+
+    const AnyGridView& grid() const { return grid_; }
+    float cellWidth() const { return cellWidth_; }
+    float cellHeight() const { return cellHeight_; }
+
+private:
+    // A ray in grid space: u = column, v = row (southwards), z; the parameter
+    // stays metres of range. [tNear, tFar] is the part that can hit the grid.
+    struct GridRay {
+        double o[3], d[3];
+        double len;
+        double tNear, tFar;
+    };
+
+    bool setupRay(const Ray& ray, GridRay& g) const;
+    bool traverse(const GridRay& g, double t, size_t level, double& tHit, size_t& r, size_t& c) const;
+    bool hitCell(size_t r, size_t c, double t, double tExit, const GridRay& g, double& tHit) const;
+    LidarReturn makeReturn(const Ray& ray, const GridRay& g, double tHit, size_t r, size_t c) const;
+#if SIM_X86
+    SIM_TARGET_AVX2 void castPacketAvx2(const RayPacket& packet, LidarReturn* returns) const;
+#endif
+
+    AnyGridView grid_;
+    float cellWidth_, cellHeight_;
+    MaxMipmap mipmap_;
+    float maxElevation_;
+    // Per-level block counts and layout of the mipmap, for vector gathers.
+    std::vector<int32_t> levelRows_, levelCols_, levelOffset_, levelBricksPerRow_;
+};
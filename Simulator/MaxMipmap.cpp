@@ -0,0 +1,103 @@
+#include "MaxMipmap.h"
+#include "HgtDecode.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Level 1 blocks per tile side; a tile covers levels 1..kTileLevels.
+static constexpr size_t kTileCells = 32;
+static constexpr size_t kTileLevels = 6;
+
+// Conservative int16 for a sample: rounded up, voids kept as kHgtVoid.
+template <typename T>
+static int16_t upperBound(const T& sample)
+{
+    const float v = sampleValue(sample);
+    if (v == static_cast<float>(kHgtVoid)) return kHgtVoid;
+    return static_cast<int16_t>(std::min(std::ceil(v), 32767.0f));
+}
+
+// Block (r, c) of 'level' from its up to 2x2 children one level down.
+void MaxMipmap::reduce(size_t level, size_t r0, size_t r1, size_t c0, size_t c1)
+{
+    const Level& src = levels_[level - 1];
+    const Level& dst = levels_[level];
+    for (size_t r = r0; r < r1; r++) {
+        const size_t sr1 = std::min(2 * r + 2, src.rows);
+        for (size_t c = c0; c < c1; c++) {
+            const size_t sc1 = std::min(2 * c + 2, src.cols);
+            int16_t m = kHgtVoid;
+            for (size_t sr = 2 * r; sr < sr1; sr++) {
+                for (size_t sc = 2 * c; sc < sc1; sc++) m = std::max(m, data_[src.index(sr, sc)]);
+            }
+            data_[dst.index(r, c)] = m;
+        }
+    }
+}
+
+template <typename T>
+MaxMipmap::MaxMipmap(const GridView<T>& grid, ThreadPool* pool)
+{
+    if (grid.rows < 2 || grid.cols < 2) throw std::invalid_argument("MaxMipmap needs at least 2x2 samples");
+
+    Level level0;
+    level0.rows = grid.rows - 1;
+    level0.cols = grid.cols - 1;
+    levels_.push_back(level0);
+    size_t blocks = 0;
+    while (levels_.back().rows > 1 || levels_.back().cols > 1) {
+        Level l;
+        l.rows = (levels_.back().rows + 1) / 2;
+        l.cols = (levels_.back().cols + 1) / 2;
+        l.bricksPerRow = (l.cols + 7) / 8;
+        l.offset = blocks;
+        blocks += ((l.rows + 7) / 8) * l.bricksPerRow * 64;
+        levels_.push_back(l);
+    }
+    data_.assign(blocks + 1, kHgtVoid);
+
+    // A single cell has nothing above level 0.
+    if (levels_.size() == 1) return;
+
+    // Each tile is taken from the samples up to level kTileLevels while it is
+    // in cache; tiles write disjoint blocks at every level.
+    const Level& level1 = levels_[1];
+    const size_t tileRows = (level1.rows + kTileCells - 1) / kTileCells;
+    const size_t tileCols = (level1.cols + kTileCells - 1) / kTileCells;
+    const size_t tiledLevels = std::min(kTileLevels, levels_.size() - 1);
+    forBands(pool, tileRows * tileCols, [&](size_t t0, size_t t1) {
+        for (size_t t = t0; t < t1; t++) {
+            const size_t tr = t / tileCols, tc = t % tileCols;
+
+            // Level 1: 3x3 samples per block (2x2 cells), clipped at the edges.
+            const Level& l1 = levels_[1];
+            const size_t r1 = std::min((tr + 1) * kTileCells, l1.rows), c1 = std::min((tc + 1) * kTileCells, l1.cols);
+            for (size_t r = tr * kTileCells; r < r1; r++) {
+                const size_t sr1 = std::min(2 * r + 2, grid.rows - 1);
+                for (size_t c = tc * kTileCells; c < c1; c++) {
+                    const size_t sc1 = std::min(2 * c + 2, grid.cols - 1);
+                    int16_t m = kHgtVoid;
+                    for (size_t sr = 2 * r; sr <= sr1; sr++) {
+                        const T* row = grid.row(sr);
+                        for (size_t sc = 2 * c; sc <= sc1; sc++) m = std::max(m, upperBound(row[sc]));
+                    }
+                    data_[l1.index(r, c)] = m;
+                }
+            }
+
+            for (size_t k = 2; k <= tiledLevels; k++) {
+                const size_t side = kTileCells >> (k - 1);
+                const Level& l = levels_[k];
+                reduce(k, tr * side, std::min((tr + 1) * side, l.rows), tc * side, std::min((tc + 1) * side, l.cols));
+            }
+        }
+    });
+
+    for (size_t k = tiledLevels + 1; k < levels_.size(); k++) {
+        forBands(pool, levels_[k].rows, [&](size_t r0, size_t r1) { reduce(k, r0, r1, 0, levels_[k].cols); });
+    }
+}
+
+template MaxMipmap::MaxMipmap(const GridView<float>&, ThreadPool*);
+template MaxMipmap::MaxMipmap(const GridView<int16_t>&, ThreadPool*);
+template MaxMipmap::MaxMipmap(const GridView<HgtSample>&, ThreadPool*);
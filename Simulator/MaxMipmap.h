@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GridView.h"
+#include "../Utils/ThreadPool.h"
+
+// Maximum mipmap over the cells of an elevation grid, for skipping terrain a
+// ray passes above. Cell (r, c) of the base grid spans samples r..r+1 and
+// c..c+1. Level k >= 1 stores, for each block of 2^k x 2^k base cells
+// (clipped to the grid), the highest valid sample on or inside it, rounded up
+// to int16. Blocks with no valid sample hold kHgtVoid. Level 0 is not stored:
+// it is the four corners of a cell, read from the grid itself.
+//
+// Levels are stored as row-major 8x8 bricks with Morton order inside each
+// brick, so the four children of a block are adjacent in memory. With int16
+// maxima all levels together take about 1/3 of the base int16 grid.
+class MaxMipmap
+{
+public:
+    // Built bottom-up in one pass per 64x64-cell tile (levels 1..6), tiles in
+    // parallel on 'pool' if given, then the few coarser levels. T is float,
+    // int16_t or HgtSample. The grid needs at least 2x2 samples.
+    template <typename T>
+    explicit MaxMipmap(const GridView<T>& grid, ThreadPool* pool = nullptr);
+
+    // Levels including 0; the last one is a single block.
+    size_t levelCount() const { return levels_.size(); }
+    size_t rows(size_t level) const { return levels_.at(level).rows; }
+    size_t cols(size_t level) const { return levels_.at(level).cols; }
+
+    // Max of block (r, c) at 'level' >= 1. No bounds checking.
+    int16_t blockMax(size_t level, size_t r, size_t c) const
+    {
+        return data_[levels_[level].index(r, c)];
+    }
+
+    // True when everything in the block is strictly below 'height'.
+    bool below(size_t level, size_t r, size_t c, float height) const
+    {
+        return static_cast<float>(blockMax(level, r, c)) < height;
+    }
+
+    size_t memoryBytes() const { return data_.size() * sizeof(int16_t); }
+
+    // Raw layout for vector kernels: all levels live in one array, level k's
+    // bricks starting at data() + levelOffset(k). One int16 of padding at the
+    // end allows 32-bit gathers of the last block.
+    const int16_t* data() const { return data_.data(); }
+    size_t levelOffset(size_t level) const { return levels_.at(level).offset; }
+    size_t bricksPerRow(size_t level) const { return levels_.at(level).bricksPerRow; }
+
+private:
+    struct Level {
+        size_t rows = 0, cols = 0;
+        size_t bricksPerRow = 0;
+        size_t offset = 0;
+
+        size_t index(size_t r, size_t c) const
+        {
+            // Interleave the low 3 bits of column (even bits) and row (odd bits).
+            static constexpr uint8_t spread[8] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+            return offset + ((r >> 3) * bricksPerRow + (c >> 3)) * 64 + (spread[c & 7] | (spread[r & 7] << 1));
+        }
+    };
+
+    void reduce(size_t level, size_t r0, size_t r1, size_t c0, size_t c1);
+
+    std::vector<Level> levels_;
+    std::vector<int16_t> data_;
+};
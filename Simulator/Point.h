@@ -0,0 +1,8 @@
+#pragma once
+
+// Simple 3D point shared by the DEM and flight path routines.
+struct Point {
+	float x_, y_, z_;
+	Point() = default;
+	Point(float x, float y, float z) : x_(x), y_(y), z_(z) {}
+};
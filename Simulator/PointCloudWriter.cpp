@@ -1 +1,41 @@
 #include "PointCloudWriter.h"
+#include <cstdio>
+#include <stdexcept>
+
+PointCloudWriter::PointCloudWriter(const std::string& path)
+    : file_(path, std::ios::binary), out_(&file_)
+{
+    if (!file_) throw std::runtime_error("cannot create point cloud file: " + path);
+}
+
+PointCloudWriter::PointCloudWriter(std::ostream& out)
+    : out_(&out)
+{
+}
+
+void PointCloudWriter::write(const PulseReturn* points, size_t n)
+{
+    // Format a block of lines at a time into one buffer.
+    char buffer[64 * 1024];
+    size_t used = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (sizeof(buffer) - used < 256) {
+            out_->write(buffer, static_cast<std::streamsize>(used));
+            used = 0;
+        }
+        const PulseReturn& p = points[i];
+        const int written = std::snprintf(buffer + used, sizeof(buffer) - used, "%.6f %.3f %.3f %.3f %.3f\n",
+            p.time, p.x, p.y, p.z, p.range);
+        if (written < 0 || static_cast<size_t>(written) >= sizeof(buffer) - used) throw std::runtime_error("point does not fit the output buffer");
+        used += static_cast<size_t>(written);
+    }
+    out_->write(buffer, static_cast<std::streamsize>(used));
+    if (!*out_) throw std::runtime_error("point cloud write failed");
+    count_ += n;
+}
+
+void PointCloudWriter::flush()
+{
+    out_->flush();
+    if (!*out_) throw std::runtime_error("point cloud write failed");
+}
@@ -1,5 +1,32 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include "PulseSimulator.h"
+
+// Writes returns as ASCII lines "time x y z range" (GPS seconds, metres),
+// one per return, in the order given.
 class PointCloudWriter
 {
-};
+public:
+    // Throws std::runtime_error if the file cannot be created.
+    explicit PointCloudWriter(const std::string& path);
+    // Writes to 'out', which must outlive the writer.
+    explicit PointCloudWriter(std::ostream& out);
+
+    PointCloudWriter(const PointCloudWriter&) = delete;
+    PointCloudWriter& operator=(const PointCloudWriter&) = delete;
 
+    // Throws std::runtime_error if the stream fails.
+    void write(const PulseReturn* points, size_t n);
+    void flush();
+
+    uint64_t pointCount() const { return count_; }
+
+private:
+    std::ofstream file_;
+    std::ostream* out_;
+    uint64_t count_ = 0;
+};
@@ -0,0 +1,166 @@
+#include "PulsePipeline.h"
+#include "ScanPattern.h"
+#include "../Utils/SpscRing.h"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+PulsePipeline::PulsePipeline(const PulseSimulator& simulator, size_t batchPulses, size_t batchesInFlight)
+    : simulator_(simulator), batchPulses_(batchPulses), batchesInFlight_(batchesInFlight)
+{
+    if (batchPulses == 0 || batchPulses % 8 != 0) throw std::invalid_argument("batch size must be a positive multiple of 8");
+    if (batchesInFlight < 2) throw std::invalid_argument("a pipeline needs at least two batches in flight");
+}
+
+namespace {
+    // One batch of consecutive pulses; every stage fills its own part.
+    // Sized once for 'capacity' pulses, so it never reallocates.
+    struct PulseBatch {
+        uint64_t first = 0;
+        size_t count = 0;
+        Platform platform;
+        std::vector<float> ox, oy, oz; // trajectory
+        std::vector<float> dx, dy, dz; // scan pattern, world frame
+        std::vector<LidarReturn> returns;
+        NoiseDraws draws;
+        std::vector<PulseReturn> points;
+
+        explicit PulseBatch(size_t capacity)
+            : ox(capacity), oy(capacity), oz(capacity), dx(capacity), dy(capacity), dz(capacity), returns(capacity)
+        {
+            draws.rangeError.resize(capacity);
+            draws.keep.resize(capacity);
+            points.reserve(capacity);
+        }
+
+        static size_t bytes(size_t capacity)
+        {
+            return sizeof(PulseBatch) + capacity * (8 * sizeof(float) + sizeof(LidarReturn) + sizeof(PulseReturn));
+        }
+    };
+}
+
+template <class Pattern>
+PipelineStats PulsePipeline::run(const Pattern& pattern, const FlightLine& line, PointCloudWriter& writer, ThreadPool* castPool) const
+{
+    const LidarSensor& sensor = simulator_.sensor();
+    const double pulseRate = simulator_.pulseRate();
+    const PulseNoise noise = simulator_.noise();
+    const uint64_t pulses = simulator_.pulseCount(line);
+
+    std::vector<PulseBatch> batches;
+    batches.reserve(batchesInFlight_);
+    for (size_t i = 0; i < batchesInFlight_; i++) batches.emplace_back(batchPulses_);
+    SpscRing<PulseBatch*> empty(batchesInFlight_), toScan(batchesInFlight_), toCast(batchesInFlight_), toNoise(batchesInFlight_),
+        toWrite(batchesInFlight_);
+    SpscRing<PulseBatch*>* rings[] = { &empty, &toScan, &toCast, &toNoise, &toWrite };
+    for (PulseBatch& b : batches) empty.tryPush(&b);
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    const auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+        for (auto* ring : rings) ring->cancel();
+    };
+    // Runs 'body' on a new thread; closes 'out' when the body has passed on
+    // its last batch.
+    const auto stage = [&fail](SpscRing<PulseBatch*>& out, auto body) {
+        return std::thread([&fail, &out, body] {
+            try {
+                body();
+                out.close();
+            } catch (...) {
+                fail();
+            }
+        });
+    };
+
+    std::thread threads[] = {
+        // Platform pose and ray origin of every pulse.
+        stage(toScan, [&] {
+            PulseBatch* b;
+            for (uint64_t first = 0; first < pulses && empty.pop(b); first += batchPulses_) {
+                b->first = first;
+                b->count = static_cast<size_t>(std::min<uint64_t>(batchPulses_, pulses - first));
+                b->platform = flightPlatform(line, pulseRate, first);
+                for (size_t i = 0; i < b->count; i++) b->platform.origin(i, b->ox[i], b->oy[i], b->oz[i]);
+                if (!toScan.push(b)) return;
+            }
+        }),
+        // Pulse directions, turned from the sensor frame to the world.
+        stage(toCast, [&] {
+            PulseBatch* b;
+            while (toScan.pop(b)) {
+                pattern.generate(b->first, b->count, b->dx.data(), b->dy.data(), b->dz.data());
+                b->platform.toWorld(b->count, b->dx.data(), b->dy.data());
+                if (!toCast.push(b)) return;
+            }
+        }),
+        // Ray casting, 8-wide packets; a short last packet repeats its final pulse.
+        stage(toNoise, [&] {
+            PulseBatch* b;
+            while (toCast.pop(b)) {
+                const size_t packets = (b->count + 7) / 8;
+                forBands(castPool, packets, [b, &sensor](size_t begin, size_t end) {
+                    RayPacket packet;
+                    LidarReturn lanes[8];
+                    for (size_t p = begin; p < end; p++) {
+                        const size_t base = 8 * p, n = std::min<size_t>(8, b->count - base);
+                        for (size_t lane = 0; lane < 8; lane++) {
+                            const size_t k = base + std::min(lane, n - 1);
+                            packet.ox[lane] = b->ox[k];
+                            packet.oy[lane] = b->oy[k];
+                            packet.oz[lane] = b->oz[k];
+                            packet.dx[lane] = b->dx[k];
+                            packet.dy[lane] = b->dy[k];
+                            packet.dz[lane] = b->dz[k];
+                        }
+                        sensor.castPacket(packet, lanes);
+                        std::copy(lanes, lanes + n, b->returns.begin() + base);
+                    }
+                });
+                if (!toNoise.push(b)) return;
+            }
+        }),
+        // Range noise and dropouts, as in PulseSimulator::simulate.
+        stage(toWrite, [&] {
+            PulseBatch* b;
+            while (toNoise.pop(b)) {
+                b->points.clear();
+                appendPulseReturns(line, pulseRate, noise, b->platform, b->first, b->count, b->returns.data(), b->draws, b->points);
+                if (!toWrite.push(b)) return;
+            }
+        }),
+    };
+
+    // The writer, on this thread, returns every batch it has written.
+    PipelineStats stats;
+    try {
+        PulseBatch* b;
+        while (toWrite.pop(b)) {
+            writer.write(b->points.data(), b->points.size());
+            stats.pulses += b->count;
+            stats.points += b->points.size();
+            if (!empty.push(b)) break;
+        }
+    } catch (...) {
+        fail();
+    }
+    for (std::thread& t : threads) t.join();
+    if (error) std::rethrow_exception(error);
+
+    stats.stalls = empty.emptyWaits();
+    stats.bufferBytes = batchesInFlight_ * PulseBatch::bytes(batchPulses_);
+    return stats;
+}
+
+template PipelineStats PulsePipeline::run(const ZigZagPattern&, const FlightLine&, PointCloudWriter&, ThreadPool*) const;
+template PipelineStats PulsePipeline::run(const PolygonPattern&, const FlightLine&, PointCloudWriter&, ThreadPool*) const;
+template PipelineStats PulsePipeline::run(const PalmerPattern&, const FlightLine&, PointCloudWriter&, ThreadPool*) const;
+template PipelineStats PulsePipeline::run(const MultiBeamPattern&, const FlightLine&, PointCloudWriter&, ThreadPool*) const;
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "PointCloudWriter.h"
+#include "PulseSimulator.h"
+#include "../Utils/ThreadPool.h"
+
+struct PipelineStats {
+    uint64_t pulses = 0;
+    uint64_t points = 0;
+    size_t stalls = 0;      // times the trajectory stage waited for a free batch
+    size_t bufferBytes = 0; // held by the batches; does not grow with the flight
+};
+
+// Streams a flight through five stages, each on its own thread:
+//
+//     trajectory -> scan pattern -> ray casting -> noise/returns -> writer
+//
+// Pulses travel in fixed-size batches through bounded SpscRing queues, and
+// the writer hands emptied batches back to the trajectory stage, so the
+// same 'batchesInFlight' batches are reused for the whole flight and memory
+// stays constant however long it is. The queues have room for every batch,
+// so no stage ever waits to pass one on; when a stage falls behind (usually
+// the writer), the batches pile up in front of it and the trajectory stage
+// waits for one to come back. The writer stage runs on the
+// calling thread; ray casting can also spread each batch over a pool.
+//
+// Returns are those of PulseSimulator::simulate with the same settings, in
+// the same order; with batchPulses equal to the simulator's slice size they
+// are identical.
+class PulsePipeline
+{
+public:
+    // Keeps a reference to 'simulator', which supplies the sensor, pulse rate
+    // and noise. batchPulses must be a multiple of 8.
+    explicit PulsePipeline(const PulseSimulator& simulator, size_t batchPulses = 4096, size_t batchesInFlight = 8);
+
+    // Instantiated for the patterns in ScanPattern.h. Rethrows the first
+    // error of any stage after stopping the others.
+    template <class Pattern>
+    PipelineStats run(const Pattern& pattern, const FlightLine& line, PointCloudWriter& writer, ThreadPool* castPool = nullptr) const;
+
+private:
+    const PulseSimulator& simulator_;
+    size_t batchPulses_;
+    size_t batchesInFlight_;
+};
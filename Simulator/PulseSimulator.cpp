@@ -0,0 +1,143 @@
+#include "PulseSimulator.h"
+#include "ScanPattern.h"
+#include "../Utils/PhiloxRng.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+PulseSimulator::PulseSimulator(const LidarSensor& sensor, double pulseRate, size_t pulsesPerSlice)
+    : sensor_(sensor), pulseRate_(pulseRate), pulsesPerSlice_(pulsesPerSlice)
+{
+    if (!(pulseRate > 0.0)) throw std::invalid_argument("pulse rate must be positive");
+    if (pulsesPerSlice == 0) throw std::invalid_argument("slices must hold at least one pulse");
+}
+
+void PulseSimulator::setNoise(const PulseNoise& noise)
+{
+    if (!(noise.rangeSigma >= 0.0f)) throw std::invalid_argument("range noise must not be negative");
+    if (!(noise.dropoutRate >= 0.0f && noise.dropoutRate <= 1.0f)) throw std::invalid_argument("dropout rate must be in [0, 1]");
+    noise_ = noise;
+}
+
+static double lineLength(const FlightLine& line)
+{
+    const double dx = double(line.end.x_) - line.start.x_, dy = double(line.end.y_) - line.start.y_, dz = double(line.end.z_) - line.start.z_;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+Platform flightPlatform(const FlightLine& line, double pulseRate, uint64_t pulse)
+{
+    // Unit direction of flight; the sensor's forward axis follows it.
+    const double length = lineLength(line);
+    double u[3] = { 0.0, 0.0, 0.0 };
+    if (length > 0.0) {
+        u[0] = (double(line.end.x_) - line.start.x_) / length;
+        u[1] = (double(line.end.y_) - line.start.y_) / length;
+        u[2] = (double(line.end.z_) - line.start.z_) / length;
+    }
+    const double metresPerPulse = line.speed / pulseRate;
+    const double along = metresPerPulse * static_cast<double>(pulse);
+    Platform platform;
+    platform.x = static_cast<float>(line.start.x_ + u[0] * along);
+    platform.y = static_cast<float>(line.start.y_ + u[1] * along);
+    platform.z = static_cast<float>(line.start.z_ + u[2] * along);
+    platform.vx = static_cast<float>(u[0] * metresPerPulse);
+    platform.vy = static_cast<float>(u[1] * metresPerPulse);
+    platform.vz = static_cast<float>(u[2] * metresPerPulse);
+    platform.heading = static_cast<float>(std::atan2(u[1], u[0]));
+    return platform;
+}
+
+void appendPulseReturns(const FlightLine& line, double pulseRate, const PulseNoise& noise, const Platform& platform,
+    uint64_t first, size_t count, const LidarReturn* returns, NoiseDraws& draws, std::vector<PulseReturn>& points)
+{
+    const PhiloxRng rng(noise.seed);
+    const bool rangeNoise = noise.rangeSigma > 0.0f, dropouts = noise.dropoutRate > 0.0f;
+    if (rangeNoise) {
+        draws.rangeError.resize(count);
+        rng.normal(first, count, PulseNoise::kRangeStream, draws.rangeError.data());
+    }
+    if (dropouts) {
+        draws.keep.resize(count);
+        rng.uniform(first, count, PulseNoise::kDropoutStream, draws.keep.data());
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const LidarReturn& ret = returns[i];
+        if (!ret.hit || (dropouts && draws.keep[i] < noise.dropoutRate)) continue;
+        const uint64_t pulse = first + i;
+        PulseReturn point{ line.startTime + static_cast<double>(pulse) / pulseRate, pulse, ret.x, ret.y, ret.z, ret.range };
+        if (rangeNoise && ret.range > 0.0f) {
+            // Slide the point along its ray by the range error.
+            const float error = noise.rangeSigma * draws.rangeError[i], scale = error / ret.range;
+            float ox, oy, oz;
+            platform.origin(i, ox, oy, oz);
+            point.x += (ret.x - ox) * scale;
+            point.y += (ret.y - oy) * scale;
+            point.z += (ret.z - oz) * scale;
+            point.range += error;
+        }
+        points.push_back(point);
+    }
+}
+
+uint64_t PulseSimulator::pulseCount(const FlightLine& line) const
+{
+    if (!(line.speed > 0.0f)) throw std::invalid_argument("flight speed must be positive");
+    return static_cast<uint64_t>(std::floor(lineLength(line) / line.speed * pulseRate_)) + 1;
+}
+
+template <class Pattern>
+std::vector<PulseReturn> PulseSimulator::simulate(const Pattern& pattern, const FlightLine& line, ThreadPool* pool) const
+{
+    const uint64_t pulses = pulseCount(line);
+    const size_t slices = static_cast<size_t>((pulses + pulsesPerSlice_ - 1) / pulsesPerSlice_);
+    if (slices > 0xffffffffu) throw std::invalid_argument("flight line needs too many slices; use larger slices");
+
+    struct Worker {
+        std::vector<LidarReturn> returns;
+        NoiseDraws draws;
+        std::vector<PulseReturn> points;
+    };
+    struct Slice {
+        size_t worker, offset, count;
+    };
+    std::vector<Worker> workers(pool ? pool->size() + 1 : 1);
+    std::vector<Slice> placed(slices);
+
+    const auto runSlice = [&](size_t s, size_t w) {
+        Worker& own = workers[w];
+        const uint64_t first = uint64_t(s) * pulsesPerSlice_;
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(pulsesPerSlice_, pulses - first));
+        const Platform platform = flightPlatform(line, pulseRate_, first);
+
+        own.returns.resize(count);
+        sensor_.scan(pattern, platform, first, count, own.returns.data());
+        placed[s] = { w, own.points.size(), 0 };
+        appendPulseReturns(line, pulseRate_, noise_, platform, first, count, own.returns.data(), own.draws, own.points);
+        placed[s].count = own.points.size() - placed[s].offset;
+    };
+    if (pool && pool->size() > 1) {
+        pool->stealingFor(slices, runSlice);
+    } else {
+        for (size_t s = 0; s < slices; s++) runSlice(s, 0);
+    }
+
+    // Slices are consecutive in time, so concatenating them in order sorts
+    // the returns by GPS time.
+    std::vector<size_t> start(slices + 1, 0);
+    for (size_t s = 0; s < slices; s++) start[s + 1] = start[s] + placed[s].count;
+    std::vector<PulseReturn> result(start[slices]);
+    forBands(pool, slices, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; s++) {
+            const PulseReturn* from = workers[placed[s].worker].points.data() + placed[s].offset;
+            std::copy(from, from + placed[s].count, result.begin() + start[s]);
+        }
+    });
+    return result;
+}
+
+template std::vector<PulseReturn> PulseSimulator::simulate(const ZigZagPattern&, const FlightLine&, ThreadPool*) const;
+template std::vector<PulseReturn> PulseSimulator::simulate(const PolygonPattern&, const FlightLine&, ThreadPool*) const;
+template std::vector<PulseReturn> PulseSimulator::simulate(const PalmerPattern&, const FlightLine&, ThreadPool*) const;
+template std::vector<PulseReturn> PulseSimulator::simulate(const MultiBeamPattern&, const FlightLine&, ThreadPool*) const;
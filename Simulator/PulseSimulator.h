@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LidarSensor.h"
+#include "Point.h"
+#include "../Utils/ThreadPool.h"
+
+// A straight flight line flown at constant speed, e.g. the endpoints from
+// FlightPath. Coordinates are in the LidarSensor world frame.
+struct FlightLine {
+    Point start, end;
+    float speed;            // metres per second
+    double startTime = 0.0; // GPS seconds of the first pulse
+};
+
+// Sensor pose at 'pulse' of 'line' flown at 'pulseRate' pulses per second:
+// position at that pulse, motion per pulse and heading along the line.
+Platform flightPlatform(const FlightLine& line, double pulseRate, uint64_t pulse);
+
+// One terrain hit.
+struct PulseReturn {
+    double time;     // GPS seconds
+    uint64_t pulse;  // index of the pulse along the flight line
+    float x, y, z;
+    float range;
+};
+
+// Measurement noise, drawn from a PhiloxRng keyed by pulse index so it is
+// the same for any slicing or thread count.
+struct PulseNoise {
+    float rangeSigma = 0.0f;  // standard deviation of range errors, metres
+    float dropoutRate = 0.0f; // probability that a hit is lost
+    uint64_t seed = 0;
+
+    // PhiloxRng streams of the two draws.
+    static constexpr uint32_t kRangeStream = 1, kDropoutStream = 2;
+};
+
+// Per-pulse noise draws, kept between calls to appendPulseReturns.
+struct NoiseDraws {
+    std::vector<float> rangeError, keep;
+};
+
+// The points of pulses first .. first+count-1 of 'line', given their
+// 'returns' and 'platform', the pose at pulse 'first': misses and dropouts
+// are left out and every hit slides along its ray by its range error.
+// Appended to 'points'. PulseSimulator and PulsePipeline both go through it,
+// so they produce the same points.
+void appendPulseReturns(const FlightLine& line, double pulseRate, const PulseNoise& noise, const Platform& platform,
+    uint64_t first, size_t count, const LidarReturn* returns, NoiseDraws& draws, std::vector<PulseReturn>& points);
+
+// Fires a scan pattern at a fixed pulse rate along a flight line and
+// collects the returns. The flight is cut into time slices of
+// 'pulsesPerSlice' pulses that are simulated independently on a pool
+// (ThreadPool::stealingFor), each worker filling its own buffers; slices
+// are then concatenated in time order, so the output is the same for any
+// thread count.
+class PulseSimulator
+{
+public:
+    // Keeps a reference to 'sensor', which must outlive the simulator.
+    PulseSimulator(const LidarSensor& sensor, double pulseRate, size_t pulsesPerSlice = size_t(1) << 16);
+
+    void setNoise(const PulseNoise& noise);
+
+    const LidarSensor& sensor() const { return sensor_; }
+    double pulseRate() const { return pulseRate_; }
+    const PulseNoise& noise() const { return noise_; }
+
+    // Pulses fired from start to end of 'line'.
+    uint64_t pulseCount(const FlightLine& line) const;
+
+    // Returns sorted by GPS time. Instantiated for the patterns in ScanPattern.h.
+    template <class Pattern>
+    std::vector<PulseReturn> simulate(const Pattern& pattern, const FlightLine& line, ThreadPool* pool = nullptr) const;
+
+private:
+    const LidarSensor& sensor_;
+    double pulseRate_;
+    size_t pulsesPerSlice_;
+    PulseNoise noise_;
+};
@@ -0,0 +1,80 @@
+#include "ScanPattern.h"
+#include <cmath>
+#include <stdexcept>
+
+static constexpr double kPi = 3.14159265358979323846;
+
+void TabulatedPattern::resize(size_t period)
+{
+    if (period == 0) throw std::invalid_argument("scan pattern period must be positive");
+    x_.assign(period, 0.0f);
+    y_.assign(period, 0.0f);
+    z_.assign(period, 0.0f);
+}
+
+static void checkFieldOfView(float fieldOfView)
+{
+    if (!(fieldOfView >= 0.0f) || fieldOfView >= static_cast<float>(kPi)) {
+        throw std::invalid_argument("field of view must be in [0, pi)");
+    }
+}
+
+ZigZagPattern::ZigZagPattern(float fieldOfView, size_t pulsesPerLine)
+{
+    checkFieldOfView(fieldOfView);
+    resize(2 * pulsesPerLine);
+    // Pulses sit at the middle of equal angle steps, so the turnarounds are
+    // not fired twice.
+    for (size_t k = 0; k < pulsesPerLine; k++) {
+        const double angle = fieldOfView * ((k + 0.5) / pulsesPerLine - 0.5);
+        const size_t back = 2 * pulsesPerLine - 1 - k;
+        x_[k] = x_[back] = 0.0f;
+        y_[k] = y_[back] = static_cast<float>(std::sin(angle));
+        z_[k] = z_[back] = static_cast<float>(-std::cos(angle));
+    }
+}
+
+PolygonPattern::PolygonPattern(float fieldOfView, size_t pulsesPerLine)
+{
+    checkFieldOfView(fieldOfView);
+    resize(pulsesPerLine);
+    for (size_t k = 0; k < pulsesPerLine; k++) {
+        const double angle = fieldOfView * ((k + 0.5) / pulsesPerLine - 0.5);
+        y_[k] = static_cast<float>(std::sin(angle));
+        z_[k] = static_cast<float>(-std::cos(angle));
+    }
+}
+
+PalmerPattern::PalmerPattern(float alongAngle, float acrossAngle, size_t pulsesPerRevolution)
+{
+    const float limit = static_cast<float>(kPi / 2);
+    if (!(alongAngle >= 0.0f && alongAngle < limit) || !(acrossAngle >= 0.0f && acrossAngle < limit)) {
+        throw std::invalid_argument("Palmer cone angles must be in [0, pi/2)");
+    }
+    resize(pulsesPerRevolution);
+    const double ta = std::tan(alongAngle), tc = std::tan(acrossAngle);
+    for (size_t k = 0; k < pulsesPerRevolution; k++) {
+        const double phase = 2.0 * kPi * k / pulsesPerRevolution;
+        const double x = ta * std::cos(phase), y = tc * std::sin(phase);
+        const double norm = std::sqrt(x * x + y * y + 1.0);
+        x_[k] = static_cast<float>(x / norm);
+        y_[k] = static_cast<float>(y / norm);
+        z_[k] = static_cast<float>(-1.0 / norm);
+    }
+}
+
+MultiBeamPattern::MultiBeamPattern(const std::vector<float>& beamElevations, size_t stepsPerRevolution)
+{
+    if (beamElevations.empty() || stepsPerRevolution == 0) {
+        throw std::invalid_argument("multi-beam pattern needs beams and azimuth steps");
+    }
+    for (float elevation : beamElevations) {
+        beamCos_.push_back(static_cast<float>(std::cos(elevation)));
+        beamSin_.push_back(static_cast<float>(std::sin(elevation)));
+    }
+    for (size_t s = 0; s < stepsPerRevolution; s++) {
+        const double azimuth = 2.0 * kPi * s / stepsPerRevolution;
+        azimuthCos_.push_back(static_cast<float>(std::cos(azimuth)));
+        azimuthSin_.push_back(static_cast<float>(std::sin(azimuth)));
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Scan patterns: the pulse direction in the sensor frame as a function of
+// pulse index. Sensor frame: x forward (along track), y left, z up; nadir is
+// (0, 0, -1). Every pattern exposes
+//
+//     void generate(uint64_t first, size_t count, float* x, float* y, float* z) const;
+//
+// writing unit directions of pulses first .. first+count-1 to separate
+// arrays. Angles are tabulated once at construction, so generating a batch
+// is table copies (and for the multi-beam head, a product of two tables)
+// with no trig per pulse. generate() is inline so LidarSensor::scan<>
+// compiles to one kernel per pattern.
+
+// A pattern that repeats every period() pulses, stored as one direction per
+// pulse of the period.
+class TabulatedPattern
+{
+public:
+    size_t period() const { return x_.size(); }
+
+    void generate(uint64_t first, size_t count, float* x, float* y, float* z) const
+    {
+        size_t k = static_cast<size_t>(first % x_.size());
+        while (count > 0) {
+            const size_t run = std::min(count, x_.size() - k);
+            std::memcpy(x, x_.data() + k, run * sizeof(float));
+            std::memcpy(y, y_.data() + k, run * sizeof(float));
+            std::memcpy(z, z_.data() + k, run * sizeof(float));
+            x += run;
+            y += run;
+            z += run;
+            count -= run;
+            k = 0;
+        }
+    }
+
+protected:
+    TabulatedPattern() = default;
+    void resize(size_t period);
+
+    std::vector<float> x_, y_, z_;
+};
+
+// Oscillating mirror: the beam swings across track from -fieldOfView/2 to
+// +fieldOfView/2 over 'pulsesPerLine' pulses and back over the next line,
+// drawing a zig-zag on the ground.
+class ZigZagPattern : public TabulatedPattern
+{
+public:
+    ZigZagPattern(float fieldOfView, size_t pulsesPerLine);
+};
+
+// Rotating polygon mirror: every facet sweeps the same way, so lines of
+// 'pulsesPerLine' pulses from -fieldOfView/2 to +fieldOfView/2 are parallel.
+class PolygonPattern : public TabulatedPattern
+{
+public:
+    PolygonPattern(float fieldOfView, size_t pulsesPerLine);
+};
+
+// Palmer scanner: a nutating mirror sweeps a cone once per
+// 'pulsesPerRevolution' pulses, starting forward and turning left. The cone
+// leans alongAngle forward and backward and acrossAngle to the sides; equal
+// angles give a circular cone, which forward motion turns into overlapping
+// ellipses on the ground.
+class PalmerPattern : public TabulatedPattern
+{
+public:
+    PalmerPattern(float alongAngle, float acrossAngle, size_t pulsesPerRevolution);
+};
+
+// Spinning multi-beam head: one laser per entry of 'beamElevations'
+// (radians above the horizontal, negative looks down), fired in order at
+// each of 'stepsPerRevolution' azimuths, starting forward and turning left.
+class MultiBeamPattern
+{
+public:
+    MultiBeamPattern(const std::vector<float>& beamElevations, size_t stepsPerRevolution);
+
+    size_t beamCount() const { return beamCos_.size(); }
+    size_t period() const { return beamCos_.size() * azimuthCos_.size(); }
+
+    void generate(uint64_t first, size_t count, float* x, float* y, float* z) const
+    {
+        const size_t beams = beamCos_.size(), steps = azimuthCos_.size();
+        size_t beam = static_cast<size_t>(first % beams);
+        size_t step = static_cast<size_t>((first / beams) % steps);
+        while (count > 0) {
+            const size_t run = std::min(count, beams - beam);
+            const float ca = azimuthCos_[step], sa = azimuthSin_[step];
+            for (size_t b = 0; b < run; b++) {
+                x[b] = beamCos_[beam + b] * ca;
+                y[b] = beamCos_[beam + b] * sa;
+                z[b] = beamSin_[beam + b];
+            }
+            x += run;
+            y += run;
+            z += run;
+            count -= run;
+            beam = 0;
+            step = step + 1 == steps ? 0 : step + 1;
+        }
+    }
+
+private:
+    std::vector<float> beamCos_, beamSin_;
+    std::vector<float> azimuthCos_, azimuthSin_;
+};
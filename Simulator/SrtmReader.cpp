@@ -2,41 +2,93 @@
 #include <limits>
 #include <algorithm>
 #include <cmath>
-#include <fstream>
+#include <filesystem>
+#include <stdexcept>
 
 
-std::vector<float> SrtmReader::getElevationData() const
+SrtmTileView SrtmReader::openTileView() const
 {
-    std::vector<float> result;
-    result.reserve(size_ * size_);
+    return SrtmTileView(filepath_, size_);
+}
 
-	std::ifstream file(filepath_, std::ios::binary);
-    if (!file) {
-		throw std::runtime_error("Cannot open HGT file: " + filepath_);
-    }
+template <typename T>
+std::vector<T> SrtmReader::getElevationData() const
+{
+    const SrtmTileView view = openTileView();
+
+    std::vector<T> result(view.sampleCount());
+    decodeHgtSamples(view.data(), result.data(), result.size());
+
+    return result;
+}
 
-    for (size_t row = 0; row < size_; row++) {
-        for (size_t col = 0; col < size_; col++) {
-			uint8_t bytres[2];
+template <typename T>
+DecodedTile<T> SrtmReader::getElevationTile() const
+{
+    const SrtmTileView view = openTileView();
 
-			file.read(reinterpret_cast<char*>(bytres), 2);
-            if (file.gcount() != 2) {
-                throw std::runtime_error("Unexpected EOF in HGT file: " + filepath_);
-            }
+    DecodedTile<T> tile;
+    tile.size = size_;
+    tile.samples.resize(view.sampleCount());
+    tile.voids = VoidMask(view.sampleCount());
+    decodeHgtSamples(view.data(), tile.samples.data(), tile.samples.size(), tile.stats, &tile.voids);
 
-			uint16_t u = (static_cast<uint16_t>(bytres[0]) << 8) | static_cast<uint16_t>(bytres[1]);
-			int16_t val = static_cast<int16_t>(u);
+    return tile;
+}
 
-            result.push_back(static_cast<float>(val));
-        }
+template <typename T>
+std::vector<T> SrtmReader::getRows(size_t begin, size_t end) const
+{
+    if (begin > end || end > size_) {
+        throw std::out_of_range("Row range outside HGT tile: " + filepath_);
     }
 
+    // Rows are contiguous, so the range is a single span of the mapping.
+    const SrtmTileView view = openTileView();
+    std::vector<T> result((end - begin) * size_);
+    decodeHgtSamples(view.data() + 2 * begin * size_, result.data(), result.size());
 
     return result;
 }
 
+template <typename T>
+std::vector<T> SrtmReader::getWindow(size_t x0, size_t y0, size_t w, size_t h) const
+{
+    if (x0 > size_ || w > size_ - x0 || y0 > size_ || h > size_ - y0) {
+        throw std::out_of_range("Window outside HGT tile: " + filepath_);
+    }
 
+    // Only the pages holding the window's rows are touched.
+    const SrtmTileView view = openTileView();
+    std::vector<T> result(w * h);
+    for (size_t row = 0; row < h; row++) {
+        const size_t idx = (y0 + row) * size_ + x0;
+        decodeHgtSamples(view.data() + 2 * idx, result.data() + row * w, w);
+    }
 
+    return result;
+}
 
+// Sample types supported by the decode kernels.
+template std::vector<float> SrtmReader::getElevationData<float>() const;
+template std::vector<int16_t> SrtmReader::getElevationData<int16_t>() const;
+template DecodedTile<float> SrtmReader::getElevationTile<float>() const;
+template DecodedTile<int16_t> SrtmReader::getElevationTile<int16_t>() const;
+template std::vector<float> SrtmReader::getRows<float>(size_t, size_t) const;
+template std::vector<int16_t> SrtmReader::getRows<int16_t>(size_t, size_t) const;
+template std::vector<float> SrtmReader::getWindow<float>(size_t, size_t, size_t, size_t) const;
+template std::vector<int16_t> SrtmReader::getWindow<int16_t>(size_t, size_t, size_t, size_t) const;
 
+size_t SrtmReader::detectTileSize(const std::string& filepath)
+{
+    std::error_code ec;
+    const auto bytes = std::filesystem::file_size(filepath, ec);
+    if (ec) {
+        throw std::runtime_error("Cannot open HGT file: " + filepath);
+    }
 
+    for (const size_t size : { size_t(3601), size_t(1201) }) {
+        if (bytes == size * size * 2) return size;
+    }
+    throw std::runtime_error("Unrecognised HGT tile size: " + filepath);
+}
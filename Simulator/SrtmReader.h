@@ -1,6 +1,18 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "SrtmTileView.h"
+#include "HgtDecode.h"
+
+// A fully decoded tile with the statistics and void mask gathered while decoding.
+template <typename T>
+struct DecodedTile {
+    size_t size = 0;
+    std::vector<T> samples;
+    HgtStats stats;
+    VoidMask voids;
+};
 
 class SrtmReader
 {
@@ -9,11 +21,42 @@ public:
         : filepath_(filepath), size_(size) {
     }
 
+    // Detect the tile size (1201 for SRTM3, 3601 for SRTM1) from the file length.
+    explicit SrtmReader(const std::string& filepath)
+        : filepath_(filepath), size_(detectTileSize(filepath)) {
+    }
+
+    // Samples per row/column of the tile.
+    size_t size() const { return size_; }
+
+    // Map the tile without decoding it. Samples are decoded on access.
+    SrtmTileView openTileView() const;
+
     // Read and return 'size_*size_' elevation samples in row-major order.
-    // Each sample is one signed 16-bit big-endian value stored as float.
-    std::vector<float> getElevationData() const;
+    // Each sample is one signed 16-bit big-endian value stored as T:
+    // float for direct use, or int16_t to keep the native metres at half the memory.
+    template <typename T = float>
+    std::vector<T> getElevationData() const;
+
+    // Decode the whole tile and, in the same pass, compute its min/max/mean,
+    // void count and void mask.
+    template <typename T = float>
+    DecodedTile<T> getElevationTile() const;
+
+    // Decode only rows [begin, end): (end-begin)*size_ samples, row-major.
+    template <typename T = float>
+    std::vector<T> getRows(size_t begin, size_t end) const;
+
+    // Decode only the 'w x h' window whose top-left sample is (x0, y0):
+    // w*h samples, row-major. x is the column, y the row.
+    template <typename T = float>
+    std::vector<T> getWindow(size_t x0, size_t y0, size_t w, size_t h) const;
+
+    // Infer the tile size from the length of an .hgt file.
+    // Throws if the file is missing or is not an SRTM1/SRTM3 tile.
+    static size_t detectTileSize(const std::string& filepath);
 
 private:
-    size_t size_;
     const std::string filepath_;
+    size_t size_;
 };
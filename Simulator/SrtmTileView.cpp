@@ -0,0 +1,118 @@
+#include "SrtmTileView.h"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SrtmTileView::SrtmTileView(const std::string& filepath, size_t size)
+    : size_(size)
+{
+    const size_t required = size_ * size_ * 2;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open HGT file: " + filepath);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) < required) {
+        CloseHandle(file);
+        throw std::runtime_error("Unexpected EOF in HGT file: " + filepath);
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map HGT file: " + filepath);
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, required);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map HGT file: " + filepath);
+    }
+
+    fileHandle_ = file;
+    mappingHandle_ = mapping;
+    data_ = static_cast<const uint8_t*>(view);
+    mappedBytes_ = required;
+#else
+    const int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open HGT file: " + filepath);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < required) {
+        ::close(fd);
+        throw std::runtime_error("Unexpected EOF in HGT file: " + filepath);
+    }
+
+    if (required == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* view = ::mmap(nullptr, required, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Cannot map HGT file: " + filepath);
+    }
+
+    data_ = static_cast<const uint8_t*>(view);
+    mappedBytes_ = required;
+#endif
+}
+
+SrtmTileView::~SrtmTileView()
+{
+    unmap();
+}
+
+SrtmTileView::SrtmTileView(SrtmTileView&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+SrtmTileView& SrtmTileView::operator=(SrtmTileView&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        size_ = std::exchange(other.size_, 0);
+        data_ = std::exchange(other.data_, nullptr);
+        mappedBytes_ = std::exchange(other.mappedBytes_, 0);
+#ifdef _WIN32
+        fileHandle_ = std::exchange(other.fileHandle_, nullptr);
+        mappingHandle_ = std::exchange(other.mappingHandle_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void SrtmTileView::unmap() noexcept
+{
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mappingHandle_) CloseHandle(mappingHandle_);
+    if (fileHandle_) CloseHandle(fileHandle_);
+    fileHandle_ = nullptr;
+    mappingHandle_ = nullptr;
+#else
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), mappedBytes_);
+#endif
+    data_ = nullptr;
+    mappedBytes_ = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory-mapped view of an SRTM .hgt tile.
+// The file is mapped as-is: 'size*size' signed 16-bit big-endian samples in
+// row-major order. Nothing is decoded up front; samples are byte-swapped on
+// access, so opening a tile only costs the mapping itself.
+class SrtmTileView
+{
+public:
+    // Empty view; holds no mapping.
+    SrtmTileView() = default;
+    SrtmTileView(const std::string& filepath, size_t size);
+    ~SrtmTileView();
+
+    SrtmTileView(const SrtmTileView&) = delete;
+    SrtmTileView& operator=(const SrtmTileView&) = delete;
+    SrtmTileView(SrtmTileView&& other) noexcept;
+    SrtmTileView& operator=(SrtmTileView&& other) noexcept;
+
+    size_t size() const { return size_; }
+    size_t sampleCount() const { return size_ * size_; }
+
+    // Raw big-endian sample bytes (2 * sampleCount() bytes).
+    const uint8_t* data() const { return data_; }
+
+    // Decode the sample at flat row-major index 'idx'. No bounds checking.
+    int16_t sample(size_t idx) const
+    {
+        const uint8_t* p = data_ + 2 * idx;
+        return static_cast<int16_t>((static_cast<uint16_t>(p[0]) << 8) | static_cast<uint16_t>(p[1]));
+    }
+
+    // Decode the sample at (row, col). No bounds checking.
+    int16_t at(size_t row, size_t col) const { return sample(row * size_ + col); }
+
+private:
+    void unmap() noexcept;
+
+    size_t size_ = 0;
+    const uint8_t* data_ = nullptr;
+    size_t mappedBytes_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
@@ -0,0 +1,251 @@
+#include "TerrainSurface.h"
+#include "HgtDecode.h"
+#include "../Utils/CpuFeatures.h"
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr float kPi = 3.14159265358979f;
+
+// Output pointers for one row of a SurfaceRaster; null where not requested.
+struct SurfaceRow {
+    float* nx = nullptr;
+    float* ny = nullptr;
+    float* nz = nullptr;
+    float* slope = nullptr;
+    float* aspect = nullptr;
+    int16_t* packed = nullptr;
+};
+
+// Horn gradients of cell j from three rows padded by one sample on each side.
+// p = dz/dx (east), q = dz/dy (north).
+static void hornGradient(const float* up, const float* mid, const float* down, size_t j,
+    float invDx8, float invDy8, float& p, float& q)
+{
+    const float voidValue = static_cast<float>(kHgtVoid);
+    const float e = mid[j + 1];
+    if (e == voidValue) {
+        p = q = 0.0f;
+        return;
+    }
+    const auto v = [&](float s) { return s == voidValue ? e : s; };
+    const float a = v(up[j]), b = v(up[j + 1]), c = v(up[j + 2]);
+    const float d = v(mid[j]), f = v(mid[j + 2]);
+    const float g = v(down[j]), hh = v(down[j + 1]), i = v(down[j + 2]);
+    p = ((c + 2.0f * f + i) - (a + 2.0f * d + g)) * invDx8;
+    q = ((a + 2.0f * b + c) - (g + 2.0f * hh + i)) * invDy8;
+}
+
+static void surfaceRowScalar(const float* up, const float* mid, const float* down, size_t w,
+    float invDx8, float invDy8, const SurfaceRow& out)
+{
+    for (size_t j = 0; j < w; j++) {
+        float p, q;
+        hornGradient(up, mid, down, j, invDx8, invDy8, p, q);
+        const float g2 = p * p + q * q;
+        const float inv = 1.0f / std::sqrt(g2 + 1.0f);
+        const float nx = -p * inv, ny = -q * inv, nz = inv;
+        if (out.nx) {
+            out.nx[j] = nx;
+            out.ny[j] = ny;
+            out.nz[j] = nz;
+        }
+        if (out.slope) out.slope[j] = std::atan(std::sqrt(g2));
+        if (out.aspect) {
+            float a = std::atan2(-p, -q);
+            if (a < 0.0f) a += 2.0f * kPi;
+            out.aspect[j] = g2 > 0.0f ? a : -1.0f;
+        }
+        if (out.packed) packNormal(nx, ny, nz, out.packed + 2 * j);
+    }
+}
+
+#if SIM_X86
+// atan2 for 8 lanes: a degree-11 odd polynomial on [0,1] plus octant fix-ups.
+SIM_TARGET_AVX2 static __m256 atan2Avx2(__m256 y, __m256 x)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 ax = _mm256_andnot_ps(signMask, x), ay = _mm256_andnot_ps(signMask, y);
+    const __m256 lo = _mm256_min_ps(ax, ay), hi = _mm256_max_ps(ax, ay);
+    const __m256 t = _mm256_and_ps(_mm256_div_ps(lo, hi), _mm256_cmp_ps(hi, _mm256_setzero_ps(), _CMP_GT_OQ));
+    const __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 r = _mm256_set1_ps(-0.01172120f);
+    r = _mm256_fmadd_ps(r, t2, _mm256_set1_ps(0.05265332f));
+    r = _mm256_fmadd_ps(r, t2, _mm256_set1_ps(-0.11643287f));
+    r = _mm256_fmadd_ps(r, t2, _mm256_set1_ps(0.19354346f));
+    r = _mm256_fmadd_ps(r, t2, _mm256_set1_ps(-0.33262347f));
+    r = _mm256_fmadd_ps(r, t2, _mm256_set1_ps(0.99997726f));
+    r = _mm256_mul_ps(r, t);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi / 2.0f), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi), r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_or_ps(r, _mm256_and_ps(y, signMask));
+}
+
+// 8 neighbours, with voids replaced by the centre values 'e'.
+SIM_TARGET_AVX2 static __m256 loadNeighbour(const float* src, __m256 e, __m256 voidValue)
+{
+    const __m256 v = _mm256_loadu_ps(src);
+    return _mm256_blendv_ps(v, e, _mm256_cmp_ps(v, voidValue, _CMP_EQ_OQ));
+}
+
+SIM_TARGET_AVX2 static size_t surfaceRowAvx2(const float* up, const float* mid, const float* down, size_t w,
+    float invDx8, float invDy8, const SurfaceRow& out)
+{
+    const __m256 voidValue = _mm256_set1_ps(static_cast<float>(kHgtVoid));
+    const __m256 two = _mm256_set1_ps(2.0f), one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    const __m256 dx = _mm256_set1_ps(invDx8), dy = _mm256_set1_ps(invDy8);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    size_t j = 0;
+    for (; j + 8 <= w; j += 8) {
+        const __m256 e = _mm256_loadu_ps(mid + j + 1);
+        const __m256 a = loadNeighbour(up + j, e, voidValue), b = loadNeighbour(up + j + 1, e, voidValue);
+        const __m256 c = loadNeighbour(up + j + 2, e, voidValue);
+        const __m256 d = loadNeighbour(mid + j, e, voidValue), f = loadNeighbour(mid + j + 2, e, voidValue);
+        const __m256 g = loadNeighbour(down + j, e, voidValue), hh = loadNeighbour(down + j + 1, e, voidValue);
+        const __m256 i = loadNeighbour(down + j + 2, e, voidValue);
+
+        const __m256 centreValid = _mm256_cmp_ps(e, voidValue, _CMP_NEQ_UQ);
+        const __m256 east = _mm256_add_ps(_mm256_fmadd_ps(two, f, c), i);
+        const __m256 west = _mm256_add_ps(_mm256_fmadd_ps(two, d, a), g);
+        const __m256 north = _mm256_add_ps(_mm256_fmadd_ps(two, b, a), c);
+        const __m256 south = _mm256_add_ps(_mm256_fmadd_ps(two, hh, g), i);
+        const __m256 p = _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(east, west), dx), centreValid);
+        const __m256 q = _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(north, south), dy), centreValid);
+
+        const __m256 g2 = _mm256_fmadd_ps(p, p, _mm256_mul_ps(q, q));
+        const __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(g2, one)));
+        const __m256 nx = _mm256_mul_ps(_mm256_xor_ps(p, signMask), inv);
+        const __m256 ny = _mm256_mul_ps(_mm256_xor_ps(q, signMask), inv);
+        if (out.nx) {
+            _mm256_storeu_ps(out.nx + j, nx);
+            _mm256_storeu_ps(out.ny + j, ny);
+            _mm256_storeu_ps(out.nz + j, inv);
+        }
+        if (out.slope) _mm256_storeu_ps(out.slope + j, atan2Avx2(_mm256_sqrt_ps(g2), one));
+        if (out.aspect) {
+            __m256 a2 = atan2Avx2(_mm256_xor_ps(p, signMask), _mm256_xor_ps(q, signMask));
+            a2 = _mm256_add_ps(a2, _mm256_and_ps(_mm256_set1_ps(2.0f * kPi), _mm256_cmp_ps(a2, zero, _CMP_LT_OQ)));
+            a2 = _mm256_blendv_ps(a2, _mm256_set1_ps(-1.0f), _mm256_cmp_ps(g2, zero, _CMP_EQ_OQ));
+            _mm256_storeu_ps(out.aspect + j, a2);
+        }
+        if (out.packed) {
+            // nz > 0 always, so no octahedral fold is needed.
+            const __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signMask, nx), _mm256_andnot_ps(signMask, ny)), inv);
+            const __m256 scale = _mm256_div_ps(_mm256_set1_ps(32767.0f), s);
+            const __m256i u = _mm256_cvtps_epi32(_mm256_mul_ps(nx, scale));
+            const __m256i v = _mm256_cvtps_epi32(_mm256_mul_ps(ny, scale));
+            // Interleave to u0 v0 u1 v1 ...; packs works per 128-bit lane, which
+            // keeps the order.
+            const __m256i packed = _mm256_packs_epi32(_mm256_unpacklo_epi32(u, v), _mm256_unpackhi_epi32(u, v));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.packed + 2 * j), packed);
+        }
+    }
+    return j;
+}
+#endif
+
+// Grid row 'r' over columns c0-1 .. c0+w (clamped to the grid) into 'dst'.
+template <typename T>
+static void loadPaddedRow(const GridView<T>& grid, size_t r, size_t c0, size_t w, float* dst)
+{
+    const T* row = grid.row(r);
+    dst[0] = sampleValue(row[c0 > 0 ? c0 - 1 : 0]);
+    for (size_t j = 0; j < w; j++) dst[j + 1] = sampleValue(row[c0 + j]);
+    dst[w + 1] = sampleValue(row[std::min(c0 + w, grid.cols - 1)]);
+}
+
+template <typename T>
+static SurfaceRaster computeSurfaceImpl(const GridView<T>& grid, size_t r0, size_t c0, size_t h, size_t w,
+    float cellWidth, float cellHeight, const SurfaceOutputs& outputs, ThreadPool* pool, bool simd)
+{
+    if (r0 > grid.rows || h > grid.rows - r0 || c0 > grid.cols || w > grid.cols - c0) {
+        throw std::out_of_range("Window outside grid");
+    }
+    if (!(cellWidth > 0.0f) || !(cellHeight > 0.0f)) throw std::invalid_argument("cell size must be positive");
+
+    SurfaceRaster raster;
+    raster.rows = h;
+    raster.cols = w;
+    const size_t n = h * w;
+    if (outputs.normals) {
+        raster.nx.resize(n);
+        raster.ny.resize(n);
+        raster.nz.resize(n);
+    }
+    if (outputs.slope) raster.slope.resize(n);
+    if (outputs.aspect) raster.aspect.resize(n);
+    if (outputs.packedNormals) raster.packedNormals.resize(2 * n);
+
+    if (n == 0) return raster;
+
+    const float invDx8 = 1.0f / (8.0f * cellWidth), invDy8 = 1.0f / (8.0f * cellHeight);
+    forBands(pool, h, [&](size_t b0, size_t b1) {
+        // Three rolling padded rows: above, at and below the output row.
+        std::vector<float> buffers(3 * (w + 2));
+        float* rows[3] = { buffers.data(), buffers.data() + (w + 2), buffers.data() + 2 * (w + 2) };
+        const size_t first = r0 + b0;
+        loadPaddedRow(grid, first > 0 ? first - 1 : 0, c0, w, rows[0]);
+        loadPaddedRow(grid, first, c0, w, rows[1]);
+
+        for (size_t k = b0; k < b1; k++) {
+            const size_t r = r0 + k;
+            loadPaddedRow(grid, std::min(r + 1, grid.rows - 1), c0, w, rows[2]);
+
+            const size_t o = k * w;
+            SurfaceRow out;
+            if (outputs.normals) {
+                out.nx = raster.nx.data() + o;
+                out.ny = raster.ny.data() + o;
+                out.nz = raster.nz.data() + o;
+            }
+            if (outputs.slope) out.slope = raster.slope.data() + o;
+            if (outputs.aspect) out.aspect = raster.aspect.data() + o;
+            if (outputs.packedNormals) out.packed = raster.packedNormals.data() + 2 * o;
+
+            size_t done = 0;
+#if SIM_X86
+            if (simd && cpuHasAvx2()) done = surfaceRowAvx2(rows[0], rows[1], rows[2], w, invDx8, invDy8, out);
+#endif
+            SurfaceRow tail = out;
+            for (float** p : { &tail.nx, &tail.ny, &tail.nz, &tail.slope, &tail.aspect }) {
+                if (*p) *p += done;
+            }
+            if (tail.packed) tail.packed += 2 * done;
+            surfaceRowScalar(rows[0] + done, rows[1] + done, rows[2] + done, w - done, invDx8, invDy8, tail);
+
+            std::rotate(rows, rows + 1, rows + 3);
+        }
+    });
+    return raster;
+}
+
+template <typename T>
+SurfaceRaster computeSurface(const GridView<T>& grid, size_t r0, size_t c0, size_t h, size_t w,
+    float cellWidth, float cellHeight, const SurfaceOutputs& outputs, ThreadPool* pool)
+{
+    return computeSurfaceImpl(grid, r0, c0, h, w, cellWidth, cellHeight, outputs, pool, true);
+}
+
+template <typename T>
+SurfaceRaster computeSurface(const GridView<T>& grid, float cellWidth, float cellHeight,
+    const SurfaceOutputs& outputs, ThreadPool* pool)
+{
+    return computeSurfaceImpl(grid, 0, 0, grid.rows, grid.cols, cellWidth, cellHeight, outputs, pool, true);
+}
+
+template <typename T>
+SurfaceRaster computeSurfaceScalar(const GridView<T>& grid, size_t r0, size_t c0, size_t h, size_t w,
+    float cellWidth, float cellHeight, const SurfaceOutputs& outputs)
+{
+    return computeSurfaceImpl(grid, r0, c0, h, w, cellWidth, cellHeight, outputs, nullptr, false);
+}
+
+template SurfaceRaster computeSurface<float>(const GridView<float>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurface<int16_t>(const GridView<int16_t>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurface<HgtSample>(const GridView<HgtSample>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurface<float>(const GridView<float>&, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurface<int16_t>(const GridView<int16_t>&, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurface<HgtSample>(const GridView<HgtSample>&, float, float, const SurfaceOutputs&, ThreadPool*);
+template SurfaceRaster computeSurfaceScalar<float>(const GridView<float>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&);
+template SurfaceRaster computeSurfaceScalar<int16_t>(const GridView<int16_t>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&);
+template SurfaceRaster computeSurfaceScalar<HgtSample>(const GridView<HgtSample>&, size_t, size_t, size_t, size_t, float, float, const SurfaceOutputs&);
@@ -0,0 +1,80 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "GridView.h"
+#include "../Utils/ThreadPool.h"
+
+// Which rasters computeSurface fills.
+struct SurfaceOutputs {
+    bool normals = true;
+    bool slope = true;
+    bool aspect = true;
+    bool packedNormals = false;
+};
+
+// Per-cell surface orientation from Horn's 3x3 stencil. Axes: x east, y north
+// (row 0 is the northern edge), z up.
+struct SurfaceRaster {
+    size_t rows = 0, cols = 0;
+    std::vector<float> nx, ny, nz;       // unit normals
+    std::vector<float> slope;            // radians from horizontal
+    std::vector<float> aspect;           // downslope direction, radians clockwise from north; -1 where flat
+    std::vector<int16_t> packedNormals;  // octahedral normals, 2 per cell (see packNormal)
+
+    size_t cellCount() const { return rows * cols; }
+};
+
+// Octahedral encoding of a unit vector as two snorm16 values (4 bytes
+// instead of 12), accurate to about 1e-4.
+inline void packNormal(float x, float y, float z, int16_t* out)
+{
+    const float s = std::fabs(x) + std::fabs(y) + std::fabs(z);
+    float u = x / s, v = y / s;
+    if (z < 0.0f) {
+        const float fu = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        v = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+    }
+    out[0] = static_cast<int16_t>(std::lrint(u * 32767.0f));
+    out[1] = static_cast<int16_t>(std::lrint(v * 32767.0f));
+}
+
+inline void unpackNormal(const int16_t* in, float& x, float& y, float& z)
+{
+    x = static_cast<float>(in[0]) / 32767.0f;
+    y = static_cast<float>(in[1]) / 32767.0f;
+    z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        const float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+    }
+    const float len = std::sqrt(x * x + y * y + z * z);
+    x /= len;
+    y /= len;
+    z /= len;
+}
+
+// Surface rasters for the 'h x w' window of 'grid' whose top-left sample is
+// (r0, c0). Neighbours just outside the window are read from the grid, so a
+// large grid can be streamed in bands of rows; at the grid edges the border
+// samples are repeated. 'cellWidth'/'cellHeight' are the sample spacings in
+// elevation units (e.g. metres). Void neighbours take the centre value; void
+// cells are flat. Rows are split into bands on 'pool' if given, and each row
+// runs through an AVX2 kernel when the CPU has it. T is float, int16_t or HgtSample.
+template <typename T>
+SurfaceRaster computeSurface(const GridView<T>& grid, size_t r0, size_t c0, size_t h, size_t w,
+    float cellWidth, float cellHeight, const SurfaceOutputs& outputs = SurfaceOutputs(), ThreadPool* pool = nullptr);
+
+// The whole grid.
+template <typename T>
+SurfaceRaster computeSurface(const GridView<T>& grid, float cellWidth, float cellHeight,
+    const SurfaceOutputs& outputs = SurfaceOutputs(), ThreadPool* pool = nullptr);
+
+// Scalar reference, single-threaded, with std::atan2 instead of the kernel's
+// polynomial (which is within 1e-5 rad).
+template <typename T>
+SurfaceRaster computeSurfaceScalar(const GridView<T>& grid, size_t r0, size_t c0, size_t h, size_t w,
+    float cellWidth, float cellHeight, const SurfaceOutputs& outputs = SurfaceOutputs());
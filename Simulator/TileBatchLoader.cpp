@@ -0,0 +1,115 @@
+#include "TileBatchLoader.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace {
+    // Indices of finished tasks, in completion order.
+    struct CompletionQueue {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<size_t> done;
+
+        void push(size_t index)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(index);
+            }
+            ready.notify_one();
+        }
+
+        size_t pop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return !done.empty(); });
+            const size_t index = done.front();
+            done.pop_front();
+            return index;
+        }
+    };
+
+    // Run load(i) for every i on the pool and call consume(i, result) on this
+    // thread in completion order. Returns the elapsed wall-clock seconds.
+    template <typename Load, typename Consume>
+    double runBatch(ThreadPool& pool, size_t count, Load load, Consume consume)
+    {
+        using Result = decltype(load(size_t(0)));
+        const auto start = std::chrono::steady_clock::now();
+
+        auto queue = std::make_shared<CompletionQueue>();
+        std::vector<std::future<Result>> futures;
+        futures.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            futures.push_back(pool.submit([queue, load, i] {
+                struct Notify {
+                    CompletionQueue& q; size_t i;
+                    ~Notify() { q.push(i); }
+                } notify{ *queue, i };
+                return load(i);
+            }));
+        }
+
+        std::exception_ptr error;
+        for (size_t n = 0; n < count; n++) {
+            const size_t i = queue->pop();
+            try {
+                consume(i, futures[i].get());
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+std::vector<std::future<DecodedTile<int16_t>>> loadTilesAsync(ThreadPool& pool, const std::vector<std::string>& paths)
+{
+    std::vector<std::future<DecodedTile<int16_t>>> futures;
+    futures.reserve(paths.size());
+    for (const auto& path : paths) {
+        futures.push_back(pool.submit([path] {
+            return SrtmReader(path).getElevationTile<int16_t>();
+        }));
+    }
+    return futures;
+}
+
+BatchLoadReport loadTiles(ThreadPool& pool, const std::vector<std::string>& paths,
+    const std::function<void(size_t index, DecodedTile<int16_t>&& tile)>& onTile)
+{
+    BatchLoadReport report;
+    report.seconds = runBatch(pool, paths.size(),
+        [&paths](size_t i) { return SrtmReader(paths[i]).getElevationTile<int16_t>(); },
+        [&](size_t i, DecodedTile<int16_t>&& tile) {
+            report.tiles++;
+            report.bytes += tile.samples.size() * 2;
+            onTile(i, std::move(tile));
+        });
+    return report;
+}
+
+BatchLoadReport loadTilesInto(ThreadPool& pool, DemMosaic& mosaic, const std::vector<std::pair<int, int>>& tiles)
+{
+    BatchLoadReport report;
+    const DemMosaic& loader = mosaic;
+    report.seconds = runBatch(pool, tiles.size(),
+        [&loader, &tiles](size_t i) { return loader.loadTile(tiles[i].first, tiles[i].second); },
+        [&](size_t i, std::shared_ptr<const DemTile>&& tile) {
+            if (tile) {
+                report.tiles++;
+                if (tile->samples.empty()) {
+                    report.mappedTiles++;
+                } else {
+                    report.bytes += tile->samples.size() * sizeof(int16_t);
+                }
+            }
+            mosaic.insertTile(tiles[i].first, tiles[i].second, std::move(tile));
+        });
+    return report;
+}
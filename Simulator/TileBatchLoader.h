@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SrtmReader.h"
+#include "DemMosaic.h"
+#include "../Utils/ThreadPool.h"
+
+// Throughput of one batch load.
+struct BatchLoadReport {
+    size_t tiles = 0;
+    size_t mappedTiles = 0; // of 'tiles', mapped without decoding (not in 'bytes')
+    size_t bytes = 0;       // HGT bytes read and decoded
+    double seconds = 0.0; // wall clock, submit to last tile
+
+    double megabytesPerSecond() const { return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0; }
+    double tilesPerSecond() const { return seconds > 0.0 ? tiles / seconds : 0.0; }
+};
+
+// Decode every tile in 'paths' concurrently on 'pool' (tile size detected
+// from the file length). One future per path, in the same order.
+std::vector<std::future<DecodedTile<int16_t>>> loadTilesAsync(ThreadPool& pool, const std::vector<std::string>& paths);
+
+// Decode every tile in 'paths' concurrently and hand each to 'onTile' on the
+// calling thread as soon as it finishes (completion order, with its index in
+// 'paths'). Rethrows the first decode error after all tasks have finished.
+BatchLoadReport loadTiles(ThreadPool& pool, const std::vector<std::string>& paths,
+    const std::function<void(size_t index, DecodedTile<int16_t>&& tile)>& onTile);
+
+// Load the (lat, lon) tiles concurrently with DemMosaic::loadTile and insert
+// each into 'mosaic' on the calling thread as it finishes. Tiles the mosaic
+// only maps are counted in 'mappedTiles', so 'bytes' stays a decode figure.
+BatchLoadReport loadTilesInto(ThreadPool& pool, DemMosaic& mosaic, const std::vector<std::pair<int, int>>& tiles);
@@ -0,0 +1,150 @@
+#include "TilePrefetcher.h"
+#include <algorithm>
+#include <cmath>
+
+// Metres per degree of latitude (mean Earth radius).
+static constexpr double kMetresPerDegree = 111320.0;
+
+TilePrefetcher::TilePrefetcher(DemMosaic& mosaic)
+    : mosaic_(mosaic)
+{
+    worker_ = std::thread(&TilePrefetcher::run, this);
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        queue_.clear();
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+size_t TilePrefetcher::prefetchCorridor(const std::vector<Point>& waypoints, double swathWidth)
+{
+    size_t queued = 0;
+    for (const auto& t : corridorTiles(waypoints, swathWidth)) {
+        if (request(t.first, t.second)) queued++;
+    }
+    return queued;
+}
+
+bool TilePrefetcher::request(int lat, int lon)
+{
+    if (mosaic_.isCached(lat, lon)) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!inFlight_.insert({ lat, lon }).second) return false;
+        queue_.emplace_back(lat, lon);
+    }
+    wake_.notify_one();
+    return true;
+}
+
+size_t TilePrefetcher::deliver()
+{
+    std::vector<Loaded> ready;
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready.swap(ready_);
+        if (!errors_.empty()) {
+            error = errors_.front();
+            errors_.pop_front();
+        }
+        // Hand the keys back now: the tiles are cached below, and a later
+        // eviction must let the corridor request them again.
+        for (const auto& r : ready) inFlight_.erase({ r.lat, r.lon });
+    }
+
+    for (auto& r : ready) {
+        mosaic_.insertTile(r.lat, r.lon, std::move(r.tile));
+    }
+    if (error) std::rethrow_exception(error);
+    return ready.size();
+}
+
+void TilePrefetcher::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && loading_ == 0; });
+}
+
+size_t TilePrefetcher::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + loading_ + ready_.size();
+}
+
+std::vector<std::pair<int, int>> TilePrefetcher::corridorTiles(const std::vector<Point>& waypoints, double swathWidth)
+{
+    std::vector<std::pair<int, int>> tiles;
+    std::set<std::pair<int, int>> seen;
+    const double halfLat = 0.5 * swathWidth / kMetresPerDegree;
+
+    auto addAround = [&](double lon, double lat) {
+        // Longitude degrees shrink towards the poles.
+        const double cosLat = std::max(std::cos(lat * 3.14159265358979323846 / 180.0), 1e-6);
+        const double halfLon = halfLat / cosLat;
+        const int lat0 = static_cast<int>(std::floor(lat - halfLat));
+        const int lat1 = static_cast<int>(std::floor(lat + halfLat));
+        const int lon0 = static_cast<int>(std::floor(lon - halfLon));
+        const int lon1 = static_cast<int>(std::floor(lon + halfLon));
+        for (int la = lat0; la <= lat1; la++) {
+            for (int lo = lon0; lo <= lon1; lo++) {
+                if (seen.insert({ la, lo }).second) tiles.emplace_back(la, lo);
+            }
+        }
+    };
+
+    // Sample each leg finely enough that no tile corner can be skipped.
+    const double maxStep = std::max(std::min(0.25, halfLat), 1e-3);
+    for (size_t i = 0; i < waypoints.size(); i++) {
+        const Point& a = waypoints[i];
+        const Point& b = (i + 1 < waypoints.size()) ? waypoints[i + 1] : a;
+        const double dx = b.x_ - a.x_;
+        const double dy = b.y_ - a.y_;
+        const int steps = std::max(1, static_cast<int>(std::ceil(std::hypot(dx, dy) / maxStep)));
+        for (int s = 0; s <= steps; s++) {
+            const double t = static_cast<double>(s) / steps;
+            addAround(a.x_ + t * dx, a.y_ + t * dy);
+        }
+    }
+    return tiles;
+}
+
+void TilePrefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (stop_) return;
+
+        const auto t = queue_.front();
+        queue_.pop_front();
+        loading_++;
+        lock.unlock();
+
+        Loaded loaded{ t.first, t.second, nullptr };
+        std::exception_ptr error;
+        try {
+            loaded.tile = mosaic_.loadTile(t.first, t.second);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        loading_--;
+        if (error) {
+            // A failed tile is not cached, so it can be retried straight away.
+            inFlight_.erase(t);
+            errors_.push_back(error);
+        } else {
+            ready_.push_back(std::move(loaded));
+        }
+        if (queue_.empty() && loading_ == 0) idle_.notify_all();
+    }
+}
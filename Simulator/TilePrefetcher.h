@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "DemMosaic.h"
+#include "FlightPath.h"
+
+// Loads the SRTM tiles a flight will need on a background thread.
+// Tiles are read with DemMosaic::loadTile on the worker and handed to the
+// mosaic by deliver(), which the simulation thread calls between pulses; the
+// mosaic itself is therefore only ever touched from the simulation thread.
+class TilePrefetcher
+{
+public:
+    explicit TilePrefetcher(DemMosaic& mosaic);
+    ~TilePrefetcher();
+
+    TilePrefetcher(const TilePrefetcher&) = delete;
+    TilePrefetcher& operator=(const TilePrefetcher&) = delete;
+
+    // Queue every tile within half the swath width of the flight path, in the
+    // order the aircraft reaches them. Waypoints are x = longitude and
+    // y = latitude in degrees; the swath width is in metres.
+    // Returns the number of newly queued tiles.
+    size_t prefetchCorridor(const std::vector<Point>& waypoints, double swathWidth);
+
+    // Queue a single tile by its south-west corner. Refused while the tile is
+    // cached or already queued, loading or awaiting deliver(); a tile that
+    // failed to load or was since evicted may be requested again.
+    bool request(int lat, int lon);
+
+    // Insert all tiles loaded so far into the mosaic, then rethrow the oldest
+    // loader error, if any; later errors are kept for the following calls.
+    // Returns the number of tiles delivered.
+    size_t deliver();
+
+    // Block until the queue is drained (tiles still need deliver()).
+    void waitIdle();
+
+    // Tiles queued or loading but not yet delivered.
+    size_t pending() const;
+
+    // Tiles (lat, lon) intersected by the corridor, in flight order, without duplicates.
+    static std::vector<std::pair<int, int>> corridorTiles(const std::vector<Point>& waypoints, double swathWidth);
+
+private:
+    struct Loaded {
+        int lat, lon;
+        std::shared_ptr<const DemTile> tile;
+    };
+
+    void run();
+
+    DemMosaic& mosaic_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::pair<int, int>> queue_;
+    std::vector<Loaded> ready_;
+    std::deque<std::exception_ptr> errors_;
+    // Tiles queued, loading or in ready_: everything between request() and deliver().
+    std::set<std::pair<int, int>> inFlight_;
+    size_t loading_ = 0;
+    bool stop_ = false;
+    std::thread worker_;
+};
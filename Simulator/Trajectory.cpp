@@ -0,0 +1,286 @@
+#include "Trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void PoseBatch::resize(size_t n)
+{
+    for (auto& row : r) row.resize(n);
+    tx.resize(n);
+    ty.resize(n);
+    tz.resize(n);
+}
+
+Trajectory::Trajectory(const std::vector<TrajectorySample>& samples)
+{
+    if (samples.size() < 2) throw std::invalid_argument("a trajectory needs at least two samples");
+    double prev[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (size_t k = 0; k < samples.size(); k++) {
+        const TrajectorySample& s = samples[k];
+        if (k > 0 && !(s.time > samples[k - 1].time)) throw std::invalid_argument("trajectory times must be strictly increasing");
+        double q[4] = { s.attitude.w, s.attitude.x, s.attitude.y, s.attitude.z };
+        const double norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        if (!(norm > 0.0)) throw std::invalid_argument("trajectory attitude must be a nonzero quaternion");
+        double dot = 0.0;
+        for (int j = 0; j < 4; j++) {
+            q[j] /= norm;
+            dot += q[j] * prev[j];
+        }
+        // q and -q are the same attitude; keep neighbours in one hemisphere.
+        if (k > 0 && dot < 0.0) {
+            for (double& v : q) v = -v;
+            dot = -dot;
+        }
+        if (k > 0) {
+            const double theta = std::acos(std::min(dot, 1.0));
+            const bool degenerate = theta < 1e-6;
+            theta_.push_back(degenerate ? 0.0f : static_cast<float>(theta));
+            invSinTheta_.push_back(degenerate ? 0.0f : static_cast<float>(1.0 / std::sin(theta)));
+        }
+        std::copy(q, q + 4, prev);
+
+        time_.push_back(s.time);
+        px_.push_back(s.x);
+        py_.push_back(s.y);
+        pz_.push_back(s.z);
+        qw_.push_back(static_cast<float>(q[0]));
+        qx_.push_back(static_cast<float>(q[1]));
+        qy_.push_back(static_cast<float>(q[2]));
+        qz_.push_back(static_cast<float>(q[3]));
+    }
+}
+
+Trajectory Trajectory::fromFlightLine(const FlightLine& line, double rate)
+{
+    if (!(rate > 0.0)) throw std::invalid_argument("trajectory rate must be positive");
+    if (!(line.speed > 0.0f)) throw std::invalid_argument("flight speed must be positive");
+    const double dx = double(line.end.x_) - line.start.x_, dy = double(line.end.y_) - line.start.y_, dz = double(line.end.z_) - line.start.z_;
+    const double length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    const double duration = length / line.speed;
+    const size_t count = std::max<size_t>(2, static_cast<size_t>(std::ceil(duration * rate)) + 1);
+
+    // Level attitude: a yaw about the vertical to the flight heading.
+    const double heading = std::atan2(dy, dx);
+    const Quaternion yaw{ static_cast<float>(std::cos(0.5 * heading)), 0.0f, 0.0f, static_cast<float>(std::sin(0.5 * heading)) };
+    std::vector<TrajectorySample> samples(count);
+    for (size_t k = 0; k < count; k++) {
+        const double t = static_cast<double>(k) / rate;
+        const double along = length > 0.0 ? t * line.speed / length : 0.0;
+        samples[k] = { line.startTime + t, static_cast<float>(line.start.x_ + dx * along), static_cast<float>(line.start.y_ + dy * along),
+            static_cast<float>(line.start.z_ + dz * along), yaw };
+    }
+    return Trajectory(samples);
+}
+
+void Trajectory::setMounting(const Quaternion& boresight, float leverX, float leverY, float leverZ)
+{
+    const float norm = std::sqrt(boresight.w * boresight.w + boresight.x * boresight.x + boresight.y * boresight.y + boresight.z * boresight.z);
+    if (!(norm > 0.0f)) throw std::invalid_argument("boresight must be a nonzero quaternion");
+    boresight_ = { boresight.w / norm, boresight.x / norm, boresight.y / norm, boresight.z / norm };
+    lever_[0] = leverX;
+    lever_[1] = leverY;
+    lever_[2] = leverZ;
+}
+
+void Trajectory::locate(const double* times, size_t n, Cursor& cursor, int32_t* segment, float* fraction) const
+{
+    const size_t last = time_.size() - 2;
+    size_t s = std::min(cursor.segment, last);
+    for (size_t i = 0; i < n; i++) {
+        const double t = times[i];
+        if (t < time_[s]) {
+            // Went backwards: search once, then walk on from there.
+            s = static_cast<size_t>(std::upper_bound(time_.begin(), time_.end() - 1, t) - time_.begin());
+            s = s > 0 ? std::min(s - 1, last) : 0;
+        }
+        while (s < last && t >= time_[s + 1]) s++;
+        const double f = (t - time_[s]) / (time_[s + 1] - time_[s]);
+        segment[i] = static_cast<int32_t>(s);
+        fraction[i] = static_cast<float>(std::min(std::max(f, 0.0), 1.0));
+    }
+    cursor.segment = s;
+}
+
+// sin(x) for x in [0, pi/2]; Taylor series to x^11.
+static float sinHalfPi(float x)
+{
+    const float x2 = x * x;
+    float p = -2.5052108e-8f;
+    p = p * x2 + 2.7557319e-6f;
+    p = p * x2 + -1.9841270e-4f;
+    p = p * x2 + 8.3333333e-3f;
+    p = p * x2 + -1.6666667e-1f;
+    return x + x * x2 * p;
+}
+
+void Trajectory::poseScalar(int32_t segment, float f, PoseBatch& out, size_t i) const
+{
+    const size_t a = static_cast<size_t>(segment), b = a + 1;
+    const float x = px_[a] + f * (px_[b] - px_[a]);
+    const float y = py_[a] + f * (py_[b] - py_[a]);
+    const float z = pz_[a] + f * (pz_[b] - pz_[a]);
+
+    float w0 = 1.0f - f, w1 = f;
+    if (invSinTheta_[a] != 0.0f) {
+        w0 = sinHalfPi((1.0f - f) * theta_[a]) * invSinTheta_[a];
+        w1 = sinHalfPi(f * theta_[a]) * invSinTheta_[a];
+    }
+    float qw = w0 * qw_[a] + w1 * qw_[b], qx = w0 * qx_[a] + w1 * qx_[b];
+    float qy = w0 * qy_[a] + w1 * qy_[b], qz = w0 * qz_[a] + w1 * qz_[b];
+    const float inv = 1.0f / std::sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+    qw *= inv;
+    qx *= inv;
+    qy *= inv;
+    qz *= inv;
+
+    // Lever arm rotated into the world: R(q) * lever.
+    const float* l = lever_;
+    out.tx[i] = x + (1.0f - 2.0f * (qy * qy + qz * qz)) * l[0] + 2.0f * (qx * qy - qw * qz) * l[1] + 2.0f * (qx * qz + qw * qy) * l[2];
+    out.ty[i] = y + 2.0f * (qx * qy + qw * qz) * l[0] + (1.0f - 2.0f * (qx * qx + qz * qz)) * l[1] + 2.0f * (qy * qz - qw * qx) * l[2];
+    out.tz[i] = z + 2.0f * (qx * qz - qw * qy) * l[0] + 2.0f * (qy * qz + qw * qx) * l[1] + (1.0f - 2.0f * (qx * qx + qy * qy)) * l[2];
+
+    // Sensor to world: q * boresight.
+    const Quaternion& m = boresight_;
+    const float sw = qw * m.w - qx * m.x - qy * m.y - qz * m.z;
+    const float sx = qw * m.x + qx * m.w + qy * m.z - qz * m.y;
+    const float sy = qw * m.y - qx * m.z + qy * m.w + qz * m.x;
+    const float sz = qw * m.z + qx * m.y - qy * m.x + qz * m.w;
+    out.r[0][i] = 1.0f - 2.0f * (sy * sy + sz * sz);
+    out.r[1][i] = 2.0f * (sx * sy - sw * sz);
+    out.r[2][i] = 2.0f * (sx * sz + sw * sy);
+    out.r[3][i] = 2.0f * (sx * sy + sw * sz);
+    out.r[4][i] = 1.0f - 2.0f * (sx * sx + sz * sz);
+    out.r[5][i] = 2.0f * (sy * sz - sw * sx);
+    out.r[6][i] = 2.0f * (sx * sz - sw * sy);
+    out.r[7][i] = 2.0f * (sy * sz + sw * sx);
+    out.r[8][i] = 1.0f - 2.0f * (sx * sx + sy * sy);
+}
+
+#if SIM_X86
+SIM_TARGET_AVX2 static __m256 sinHalfPiAvx2(__m256 x)
+{
+    const __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-2.5052108e-8f);
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(2.7557319e-6f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(-1.9841270e-4f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(8.3333333e-3f));
+    p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(-1.6666667e-1f));
+    return _mm256_fmadd_ps(_mm256_mul_ps(x, x2), p, x);
+}
+
+// a + f * (b - a)
+SIM_TARGET_AVX2 static __m256 lerp(__m256 a, __m256 b, __m256 f)
+{
+    return _mm256_fmadd_ps(f, _mm256_sub_ps(b, a), a);
+}
+
+// 2 * (a * b + c * d)
+SIM_TARGET_AVX2 static __m256 twice(__m256 a, __m256 b, __m256 c, __m256 d)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+    return _mm256_mul_ps(two, _mm256_fmadd_ps(a, b, _mm256_mul_ps(c, d)));
+}
+
+// 1 - 2 * (a * a + b * b)
+SIM_TARGET_AVX2 static __m256 oneMinusTwice(__m256 a, __m256 b)
+{
+    return _mm256_fnmadd_ps(_mm256_set1_ps(2.0f), _mm256_fmadd_ps(a, a, _mm256_mul_ps(b, b)), _mm256_set1_ps(1.0f));
+}
+
+void Trajectory::poseAvx2(const int32_t* segment, const float* fraction, PoseBatch& out, size_t i) const
+{
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(segment));
+    const __m256i b = _mm256_add_epi32(a, _mm256_set1_epi32(1));
+    const __m256 f = _mm256_loadu_ps(fraction);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    const __m256 x = lerp(_mm256_i32gather_ps(px_.data(), a, 4), _mm256_i32gather_ps(px_.data(), b, 4), f);
+    const __m256 y = lerp(_mm256_i32gather_ps(py_.data(), a, 4), _mm256_i32gather_ps(py_.data(), b, 4), f);
+    const __m256 z = lerp(_mm256_i32gather_ps(pz_.data(), a, 4), _mm256_i32gather_ps(pz_.data(), b, 4), f);
+
+    // Slerp weights from the segment's precomputed angle; lerp where it is 0.
+    const __m256 theta = _mm256_i32gather_ps(theta_.data(), a, 4);
+    const __m256 invSin = _mm256_i32gather_ps(invSinTheta_.data(), a, 4);
+    const __m256 g = _mm256_sub_ps(one, f);
+    const __m256 flat = _mm256_cmp_ps(invSin, _mm256_setzero_ps(), _CMP_EQ_OQ);
+    const __m256 w0 = _mm256_blendv_ps(_mm256_mul_ps(sinHalfPiAvx2(_mm256_mul_ps(g, theta)), invSin), g, flat);
+    const __m256 w1 = _mm256_blendv_ps(_mm256_mul_ps(sinHalfPiAvx2(_mm256_mul_ps(f, theta)), invSin), f, flat);
+
+    __m256 qw = _mm256_fmadd_ps(w0, _mm256_i32gather_ps(qw_.data(), a, 4), _mm256_mul_ps(w1, _mm256_i32gather_ps(qw_.data(), b, 4)));
+    __m256 qx = _mm256_fmadd_ps(w0, _mm256_i32gather_ps(qx_.data(), a, 4), _mm256_mul_ps(w1, _mm256_i32gather_ps(qx_.data(), b, 4)));
+    __m256 qy = _mm256_fmadd_ps(w0, _mm256_i32gather_ps(qy_.data(), a, 4), _mm256_mul_ps(w1, _mm256_i32gather_ps(qy_.data(), b, 4)));
+    __m256 qz = _mm256_fmadd_ps(w0, _mm256_i32gather_ps(qz_.data(), a, 4), _mm256_mul_ps(w1, _mm256_i32gather_ps(qz_.data(), b, 4)));
+    const __m256 norm2 = _mm256_fmadd_ps(qw, qw, _mm256_fmadd_ps(qx, qx, _mm256_fmadd_ps(qy, qy, _mm256_mul_ps(qz, qz))));
+    const __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(norm2));
+    qw = _mm256_mul_ps(qw, inv);
+    qx = _mm256_mul_ps(qx, inv);
+    qy = _mm256_mul_ps(qy, inv);
+    qz = _mm256_mul_ps(qz, inv);
+
+    // Lever arm rotated into the world: R(q) * lever.
+    const __m256 l0 = _mm256_set1_ps(lever_[0]), l1 = _mm256_set1_ps(lever_[1]), l2 = _mm256_set1_ps(lever_[2]);
+    const __m256 nqw = _mm256_sub_ps(_mm256_setzero_ps(), qw);
+    __m256 t = _mm256_fmadd_ps(oneMinusTwice(qy, qz), l0, x);
+    t = _mm256_fmadd_ps(twice(qx, qy, nqw, qz), l1, t);
+    _mm256_storeu_ps(out.tx.data() + i, _mm256_fmadd_ps(twice(qx, qz, qw, qy), l2, t));
+    t = _mm256_fmadd_ps(twice(qx, qy, qw, qz), l0, y);
+    t = _mm256_fmadd_ps(oneMinusTwice(qx, qz), l1, t);
+    _mm256_storeu_ps(out.ty.data() + i, _mm256_fmadd_ps(twice(qy, qz, nqw, qx), l2, t));
+    t = _mm256_fmadd_ps(twice(qx, qz, nqw, qy), l0, z);
+    t = _mm256_fmadd_ps(twice(qy, qz, qw, qx), l1, t);
+    _mm256_storeu_ps(out.tz.data() + i, _mm256_fmadd_ps(oneMinusTwice(qx, qy), l2, t));
+
+    // Sensor to world: q * boresight.
+    const __m256 mw = _mm256_set1_ps(boresight_.w), mx = _mm256_set1_ps(boresight_.x);
+    const __m256 my = _mm256_set1_ps(boresight_.y), mz = _mm256_set1_ps(boresight_.z);
+    const __m256 sw = _mm256_sub_ps(_mm256_mul_ps(qw, mw), _mm256_fmadd_ps(qx, mx, _mm256_fmadd_ps(qy, my, _mm256_mul_ps(qz, mz))));
+    const __m256 sx = _mm256_fmadd_ps(qw, mx, _mm256_fmadd_ps(qx, mw, _mm256_fmsub_ps(qy, mz, _mm256_mul_ps(qz, my))));
+    const __m256 sy = _mm256_fmadd_ps(qw, my, _mm256_fmadd_ps(qy, mw, _mm256_fmsub_ps(qz, mx, _mm256_mul_ps(qx, mz))));
+    const __m256 sz = _mm256_fmadd_ps(qw, mz, _mm256_fmadd_ps(qz, mw, _mm256_fmsub_ps(qx, my, _mm256_mul_ps(qy, mx))));
+    const __m256 nsw = _mm256_sub_ps(_mm256_setzero_ps(), sw);
+    _mm256_storeu_ps(out.r[0].data() + i, oneMinusTwice(sy, sz));
+    _mm256_storeu_ps(out.r[1].data() + i, twice(sx, sy, nsw, sz));
+    _mm256_storeu_ps(out.r[2].data() + i, twice(sx, sz, sw, sy));
+    _mm256_storeu_ps(out.r[3].data() + i, twice(sx, sy, sw, sz));
+    _mm256_storeu_ps(out.r[4].data() + i, oneMinusTwice(sx, sz));
+    _mm256_storeu_ps(out.r[5].data() + i, twice(sy, sz, nsw, sx));
+    _mm256_storeu_ps(out.r[6].data() + i, twice(sx, sz, nsw, sy));
+    _mm256_storeu_ps(out.r[7].data() + i, twice(sy, sz, sw, sx));
+    _mm256_storeu_ps(out.r[8].data() + i, oneMinusTwice(sx, sy));
+}
+#endif
+
+void Trajectory::interpolate(const double* times, size_t n, Cursor& cursor, PoseBatch& out) const
+{
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        out.resize(n);
+        // Locate a chunk of times, then interpolate it 8 at a time.
+        const size_t chunk = 512;
+        int32_t segment[chunk];
+        float fraction[chunk];
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            const size_t m = std::min(chunk, n - begin);
+            locate(times + begin, m, cursor, segment, fraction);
+            size_t j = 0;
+            for (; j + 8 <= m; j += 8) poseAvx2(segment + j, fraction + j, out, begin + j);
+            for (; j < m; j++) poseScalar(segment[j], fraction[j], out, begin + j);
+        }
+        return;
+    }
+#endif
+    interpolateScalar(times, n, cursor, out);
+}
+
+void Trajectory::interpolateScalar(const double* times, size_t n, Cursor& cursor, PoseBatch& out) const
+{
+    out.resize(n);
+    const size_t chunk = 512;
+    int32_t segment[chunk];
+    float fraction[chunk];
+    for (size_t begin = 0; begin < n; begin += chunk) {
+        const size_t m = std::min(chunk, n - begin);
+        locate(times + begin, m, cursor, segment, fraction);
+        for (size_t j = 0; j < m; j++) poseScalar(segment[j], fraction[j], out, begin + j);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PulseSimulator.h"
+#include "../Utils/CpuFeatures.h"
+
+// Unit quaternion (w, x, y, z).
+struct Quaternion {
+    float w = 1.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+};
+
+// One IMU/GNSS record. The attitude rotates the body frame (x forward,
+// y left, z up, as the sensor frame of ScanPattern.h) into the LidarSensor
+// world frame.
+struct TrajectorySample {
+    double time; // GPS seconds
+    float x, y, z;
+    Quaternion attitude;
+};
+
+// Sensor-to-world transforms in structure-of-arrays form:
+// world = R * sensor + t, with R row-major in r[0..8].
+struct PoseBatch {
+    std::vector<float> r[9];
+    std::vector<float> tx, ty, tz;
+
+    size_t size() const { return tx.size(); }
+    void resize(size_t n);
+};
+
+// A trajectory sampled at a low rate (e.g. a 200 Hz IMU/GNSS solution),
+// interpolated to pulse timestamps: positions linearly, attitudes by slerp.
+// Pulse times arrive sorted, so interpolate() walks the samples with a
+// cursor instead of searching; per-segment slerp angles are precomputed,
+// and with AVX2 eight timestamps are interpolated per step.
+class Trajectory
+{
+public:
+    // Needs at least two samples with strictly increasing times. Attitudes
+    // are normalized and sign-aligned with their predecessor so that slerp
+    // takes the short way.
+    explicit Trajectory(const std::vector<TrajectorySample>& samples);
+
+    // Level flight along 'line' sampled at 'rate' Hz, heading along the line.
+    static Trajectory fromFlightLine(const FlightLine& line, double rate = 200.0);
+
+    // Sensor mounting on the body: 'boresight' rotates the sensor frame into
+    // the body frame, and the lever arm is the sensor origin in body axes.
+    void setMounting(const Quaternion& boresight, float leverX, float leverY, float leverZ);
+
+    double startTime() const { return time_.front(); }
+    double endTime() const { return time_.back(); }
+    size_t sampleCount() const { return time_.size(); }
+
+    // Position in the sample sequence, carried between interpolate() calls.
+    struct Cursor {
+        size_t segment = 0;
+    };
+
+    // Sensor-to-world transforms at 'times', which should be non-decreasing
+    // within a call and across calls sharing 'cursor' (an earlier time costs
+    // a binary search). Times outside the trajectory clamp to its ends.
+    // Dispatches to the AVX2 kernel when available.
+    void interpolate(const double* times, size_t n, Cursor& cursor, PoseBatch& out) const;
+
+    // Same, always scalar.
+    void interpolateScalar(const double* times, size_t n, Cursor& cursor, PoseBatch& out) const;
+
+private:
+    // Segment and fraction within it for each time.
+    void locate(const double* times, size_t n, Cursor& cursor, int32_t* segment, float* fraction) const;
+    void poseScalar(int32_t segment, float fraction, PoseBatch& out, size_t i) const;
+#if SIM_X86
+    SIM_TARGET_AVX2 void poseAvx2(const int32_t* segment, const float* fraction, PoseBatch& out, size_t i) const;
+#endif
+
+    std::vector<double> time_;
+    std::vector<float> px_, py_, pz_;
+    std::vector<float> qw_, qx_, qy_, qz_;
+    // Per segment: angle between its end attitudes and 1/sin of it (0 when
+    // the attitudes coincide, where slerp degenerates to lerp).
+    std::vector<float> theta_, invSinTheta_;
+    Quaternion boresight_;
+    float lever_[3] = { 0.0f, 0.0f, 0.0f };
+};
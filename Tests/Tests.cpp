@@ -1,6 +1,32 @@
 #define CATCH_CONFIG_MAIN
 #include "catch_amalgamated.hpp"
 #include "../Simulator/SrtmReader.h"
+#include "../Simulator/HgtDecode.h"
+#include "../Simulator/DemMaker.h"
+#include "../Simulator/DemMosaic.h"
+#include "../Simulator/TilePrefetcher.h"
+#include "../Simulator/TileBatchLoader.h"
+#include "../Simulator/DemPyramid.h"
+#include "../Simulator/HeightSampler.h"
+#include "../Simulator/MaxMipmap.h"
+#include "../Simulator/TerrainSurface.h"
+#include "../Simulator/LidarSensor.h"
+#include "../Simulator/ScanPattern.h"
+#include "../Simulator/PulseSimulator.h"
+#include "../Simulator/FlightPath.h"
+#include "../Simulator/PulsePipeline.h"
+#include "../Simulator/Trajectory.h"
+#include "../Utils/PhiloxRng.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 TEST_CASE("DemTerrain loads HGT file and retrieves elevation data correctly", "[DemTerrain]")
 {
@@ -19,3 +45,1529 @@ TEST_CASE("DemTerrain loads HGT file and retrieves elevation data correctly", "[
     ////REQUIRE(elevation2 == Catch::Approx(779.0).margin(1.0));
     ////REQUIRE(elevation3 == Catch::Approx(1381.0).margin(1.0));
 }
+
+// Write a 'size x size' HGT tile (big-endian int16) with samples value(row, col).
+template <typename ValueFn>
+static void writeHgt(const std::string& path, size_t size, ValueFn value)
+{
+    std::ofstream out(path, std::ios::binary);
+    for (size_t row = 0; row < size; row++) {
+        for (size_t col = 0; col < size; col++) {
+            const uint16_t u = static_cast<uint16_t>(static_cast<int16_t>(value(row, col)));
+            const char bytes[2] = { static_cast<char>(u >> 8), static_cast<char>(u & 0xFF) };
+            out.write(bytes, 2);
+        }
+    }
+}
+
+// Write a synthetic 'size x size' HGT tile to the temp directory and return its path.
+static std::string writeSyntheticHgt(const std::string& name, size_t size)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / name).string();
+    writeHgt(path, size, [](size_t row, size_t col) {
+        return static_cast<int>(row * 7 + col * 3) % 9000 - 500;
+    });
+    return path;
+}
+
+TEST_CASE("SrtmTileView decodes mapped samples on demand", "[SrtmReader]")
+{
+    const size_t size = 101;
+    const std::string filepath = writeSyntheticHgt("tileview_101.hgt", size);
+
+    SrtmReader reader(filepath, size);
+    const SrtmTileView view = reader.openTileView();
+    REQUIRE(view.size() == size);
+    REQUIRE(view.at(0, 0) == -500);
+    REQUIRE(view.at(10, 20) == 10 * 7 + 20 * 3 - 500);
+
+    const std::vector<float> elevations = reader.getElevationData();
+    REQUIRE(elevations.size() == size * size);
+    REQUIRE(elevations[100 * size + 100] == static_cast<float>(view.at(100, 100)));
+
+    REQUIRE_THROWS_AS(SrtmReader(filepath, size + 1).openTileView(), std::runtime_error);
+}
+
+TEST_CASE("decodeHgtSamples matches the scalar kernel", "[SrtmReader]")
+{
+    // Odd count so the SIMD kernels also exercise their scalar tail.
+    const size_t count = 1037;
+    std::vector<uint8_t> raw(2 * count);
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t u = static_cast<uint16_t>(i * 2654435761u);
+        raw[2 * i] = static_cast<uint8_t>(u >> 8);
+        raw[2 * i + 1] = static_cast<uint8_t>(u & 0xFF);
+    }
+    raw[0] = 0x80; raw[1] = 0x00; // SRTM void, -32768
+
+    std::vector<float> expected(count), actual(count);
+    decodeHgtSamplesScalar(raw.data(), expected.data(), count);
+    decodeHgtSamples(raw.data(), actual.data(), count);
+
+    REQUIRE(expected[0] == -32768.0f);
+    REQUIRE(actual == expected);
+}
+
+// Per-sample ifstream reader that getElevationData used before the mapped
+// bulk decode; kept here only as the benchmark baseline.
+static std::vector<float> readHgtPerSample(const std::string& filepath, size_t size)
+{
+    std::vector<float> result;
+    result.reserve(size * size);
+    std::ifstream file(filepath, std::ios::binary);
+    for (size_t i = 0; i < size * size; i++) {
+        uint8_t bytes[2];
+        file.read(reinterpret_cast<char*>(bytes), 2);
+        const uint16_t u = (static_cast<uint16_t>(bytes[0]) << 8) | static_cast<uint16_t>(bytes[1]);
+        result.push_back(static_cast<float>(static_cast<int16_t>(u)));
+    }
+    return result;
+}
+
+TEST_CASE("SRTM1 tile load: per-sample read vs bulk decode", "[.][benchmark][SrtmReader]")
+{
+    const size_t size = 3601;
+    const std::string filepath = writeSyntheticHgt("bench_3601.hgt", size);
+    SrtmReader reader(filepath, size);
+
+    REQUIRE(reader.getElevationData() == readHgtPerSample(filepath, size));
+
+    BENCHMARK("per-sample ifstream") {
+        return readHgtPerSample(filepath, size);
+    };
+    BENCHMARK("mapped bulk decode") {
+        return reader.getElevationData();
+    };
+}
+
+TEST_CASE("SrtmReader detects tile size and decodes row ranges and windows", "[SrtmReader]")
+{
+    const size_t size = 1201;
+    const std::string filepath = writeSyntheticHgt("rows_1201.hgt", size);
+
+    SrtmReader reader(filepath);
+    REQUIRE(reader.size() == size);
+    const SrtmTileView view = reader.openTileView();
+
+    const std::vector<float> rows = reader.getRows(10, 13);
+    REQUIRE(rows.size() == 3 * size);
+    REQUIRE(rows[0] == view.at(10, 0));
+    REQUIRE(rows[2 * size + 5] == view.at(12, 5));
+
+    const std::vector<float> window = reader.getWindow(300, 200, 7, 4);
+    REQUIRE(window.size() == 28);
+    REQUIRE(window[0] == view.at(200, 300));
+    REQUIRE(window[3 * 7 + 6] == view.at(203, 306));
+
+    REQUIRE_THROWS_AS(reader.getWindow(1200, 0, 2, 1), std::out_of_range);
+    REQUIRE_THROWS_AS(SrtmReader(writeSyntheticHgt("odd_100.hgt", 100)), std::runtime_error);
+}
+
+// Write a 2x2 block of 'size x size' tiles (N34..N35, W117..W116) whose samples
+// encode their global position, so shared edges hold identical values in both
+// tiles. Returns the directory.
+static std::filesystem::path writeMosaicTiles(size_t size)
+{
+    const int perDegree = static_cast<int>(size - 1);
+    const auto dir = std::filesystem::temp_directory_path() / ("mosaic_" + std::to_string(size));
+    std::filesystem::create_directories(dir);
+    for (int lat = 34; lat <= 35; lat++) {
+        for (int lon = -117; lon <= -116; lon++) {
+            writeHgt((dir / (DemMosaic::tileName(lat, lon) + ".hgt")).string(), size, [&](size_t row, size_t col) {
+                const int gy = (lat + 1) * perDegree - static_cast<int>(row);
+                const int gx = lon * perDegree + static_cast<int>(col);
+                return (gy - 340) * 100 + (gx + 1170);
+            });
+        }
+    }
+    return dir;
+}
+
+TEST_CASE("DemMosaic looks up elevations seamlessly across tile edges", "[DemMosaic]")
+{
+    const size_t size = 11;
+    const auto dir = writeMosaicTiles(size);
+
+    REQUIRE(DemMosaic::tileName(35, -116) == "N35W116");
+    REQUIRE(DemMosaic::tileName(-1, 5) == "S01E005");
+    REQUIRE_THROWS_AS(DemMosaic::tileName(91, 0), std::out_of_range);
+    REQUIRE_THROWS_AS(DemMosaic::tileName(0, -181), std::out_of_range);
+
+    const size_t tileBytes = size * size * 2;
+    DemMosaic mosaic(dir.string(), size, 2 * tileBytes);
+
+    // Walk across both the latitude and longitude seams.
+    for (int gy = 345; gy <= 355; gy++) {
+        for (int gx = -1165; gx <= -1155; gx++) {
+            REQUIRE(mosaic.sampleAt(gy, gx) == static_cast<float>((gy - 340) * 100 + (gx + 1170)));
+        }
+    }
+    REQUIRE(mosaic.elevationAt(35.0, -116.0) == static_cast<float>(10 * 100 + 10));
+    REQUIRE(mosaic.elevationAt(50.5, 10.5) == DemMosaic::kVoidElevation);
+
+    const DemMosaic::Stats stats = mosaic.stats();
+    // 4 tiles on the walk, one reload after eviction, one missing tile.
+    REQUIRE(stats.misses == 6);
+    REQUIRE(stats.evictions > 0);
+    REQUIRE(stats.bytesCached <= 2 * tileBytes);
+
+    mosaic.setMemoryBudget(0);
+    REQUIRE(mosaic.stats().tilesCached == 1);
+}
+
+TEST_CASE("TilePrefetcher loads corridor tiles ahead of the simulation", "[DemMosaic]")
+{
+    // East-bound leg along 35.5N: only the two northern tiles are touched.
+    const std::vector<Point> leg = { Point(-116.5f, 35.5f, 3000.0f), Point(-115.5f, 35.5f, 3000.0f) };
+    const auto tiles = TilePrefetcher::corridorTiles(leg, 2000.0);
+    REQUIRE(tiles == std::vector<std::pair<int, int>>{ { 35, -117 }, { 35, -116 } });
+
+    // Flying just north of a tile edge, the swath reaches into the southern row.
+    const std::vector<Point> edge = { Point(-116.5f, 35.001f, 3000.0f), Point(-116.4f, 35.001f, 3000.0f) };
+    REQUIRE(TilePrefetcher::corridorTiles(edge, 1000.0).size() == 2);
+
+    const size_t size = 11;
+    DemMosaic mosaic(writeMosaicTiles(size).string(), size, 16 * size * size * 2);
+    TilePrefetcher prefetcher(mosaic);
+    REQUIRE(prefetcher.prefetchCorridor(leg, 2000.0) == 2);
+    REQUIRE(prefetcher.prefetchCorridor(leg, 2000.0) == 0);
+
+    prefetcher.waitIdle();
+    REQUIRE(prefetcher.deliver() == 2);
+    REQUIRE(prefetcher.pending() == 0);
+    REQUIRE(mosaic.isCached(35, -117));
+    REQUIRE(mosaic.isCached(35, -116));
+
+    mosaic.elevationAt(35.5, -116.5);
+    REQUIRE(mosaic.stats().misses == 0);
+
+    // An evicted tile can be prefetched again when the flight comes back.
+    mosaic.setMemoryBudget(0);
+    mosaic.setMemoryBudget(16 * size * size * 2);
+    REQUIRE(!mosaic.isCached(35, -116));
+    REQUIRE(prefetcher.prefetchCorridor(leg, 2000.0) == 1);
+    prefetcher.waitIdle();
+    REQUIRE(prefetcher.deliver() == 1);
+
+    // A failed load is reported once and the tile can be retried.
+    const std::string broken = mosaic.tilePath(36, -117);
+    writeHgt(broken, 3, [](size_t, size_t) { return 0; });
+    REQUIRE(prefetcher.request(36, -117));
+    REQUIRE(prefetcher.request(36, -116));
+    prefetcher.waitIdle();
+    REQUIRE_THROWS_AS(prefetcher.deliver(), std::runtime_error);
+    REQUIRE(prefetcher.deliver() == 0);
+    writeHgt(broken, size, [](size_t, size_t) { return 7; });
+    REQUIRE(prefetcher.request(36, -117));
+    prefetcher.waitIdle();
+    REQUIRE(prefetcher.deliver() == 1);
+    REQUIRE(mosaic.isCached(36, -117));
+    std::filesystem::remove(broken);
+}
+
+TEST_CASE("Native int16 samples flow through SrtmReader and DemMaker", "[SrtmReader][DemMaker]")
+{
+    const size_t size = 101;
+    SrtmReader reader(writeSyntheticHgt("native_101.hgt", size), size);
+
+    const std::vector<float> asFloat = reader.getElevationData();
+    const std::vector<int16_t> native = reader.getElevationData<int16_t>();
+    REQUIRE(std::vector<float>(native.begin(), native.end()) == asFloat);
+    REQUIRE(reader.getWindow<int16_t>(5, 6, 3, 2)[4] == native[7 * size + 6]);
+
+    const std::vector<Point> fromFloat = getNormalizePoints(asFloat, 4);
+    const std::vector<Point> fromNative = getNormalizePoints(native, 4);
+    REQUIRE(fromNative.size() == fromFloat.size());
+    REQUIRE(std::equal(fromNative.begin(), fromNative.end(), fromFloat.begin(),
+        [](const Point& a, const Point& b) { return a.x_ == b.x_ && a.y_ == b.y_ && a.z_ == b.z_; }));
+}
+
+TEST_CASE("Tile decode gathers void-aware statistics and voids can be filled", "[SrtmReader][DemMaker]")
+{
+    const size_t size = 61;
+    const std::string filepath = (std::filesystem::temp_directory_path() / "voids_61.hgt").string();
+    // Gentle slope with a 3x3 void hole in the middle and one void in a corner.
+    writeHgt(filepath, size, [](size_t row, size_t col) {
+        const bool hole = (row >= 29 && row <= 31 && col >= 29 && col <= 31) || (row == 60 && col == 60);
+        return hole ? kHgtVoid : static_cast<int>(100 + row + col);
+    });
+
+    SrtmReader reader(filepath, size);
+    DecodedTile<int16_t> tile = reader.getElevationTile<int16_t>();
+    REQUIRE(tile.stats.voidCount == 10);
+    REQUIRE(tile.stats.validCount == size * size - 10);
+    REQUIRE(tile.stats.minValue == 100);
+    REQUIRE(tile.stats.maxValue == 100 + 60 + 59);
+    REQUIRE(tile.voids.test(30 * size + 30));
+    REQUIRE_FALSE(tile.voids.test(30 * size + 28));
+
+    // Same statistics from the float decode and from the scalar reference.
+    const DecodedTile<float> asFloat = reader.getElevationTile<float>();
+    REQUIRE(asFloat.stats.sum == tile.stats.sum);
+    REQUIRE(asFloat.voids.words == tile.voids.words);
+
+    // The voids no longer drag the normalisation down.
+    const std::vector<Point> points = getNormalizePoints(tile.samples, tile.stats, 1);
+    REQUIRE(points.front().z_ == -1.0f);
+    REQUIRE(points[size * size - 2].z_ == 1.0f);
+    REQUIRE(points[30 * size + 30].z_ == -1.0f);
+    const std::vector<Point> scanned = getNormalizePoints(tile.samples, 1);
+    REQUIRE(scanned[30 * size + 31].z_ == points[30 * size + 31].z_);
+
+    ThreadPool pool(4);
+    std::vector<int16_t> pooled = tile.samples;
+    REQUIRE(fillVoids(pooled, tile.voids, VoidFill::InverseDistance, 32, &pool) == 10);
+    REQUIRE(fillVoids(tile.samples, tile.voids, VoidFill::InverseDistance) == 10);
+    REQUIRE(pooled == tile.samples);
+    REQUIRE(tile.samples[30 * size + 30] == 160);
+    REQUIRE(tile.samples[size * size - 1] != kHgtVoid);
+
+    std::vector<float> nearest = asFloat.samples;
+    REQUIRE(fillVoids(nearest, asFloat.voids, VoidFill::Nearest) == 10);
+    REQUIRE(nearest[29 * size + 29] == 100.0f + 28 + 29);
+}
+
+TEST_CASE("Tile batches decode concurrently on a thread pool", "[DemMosaic]")
+{
+    std::vector<std::string> paths;
+    for (int i = 0; i < 4; i++) {
+        paths.push_back(writeSyntheticHgt("batch_" + std::to_string(i) + ".hgt", 1201));
+    }
+
+    ThreadPool pool(4);
+    auto futures = loadTilesAsync(pool, paths);
+    REQUIRE(futures.size() == 4);
+    const DecodedTile<int16_t> first = futures[0].get();
+    REQUIRE(first.size == 1201);
+    REQUIRE(first.stats.voidCount == 0);
+
+    std::vector<bool> seen(paths.size(), false);
+    const BatchLoadReport report = loadTiles(pool, paths, [&](size_t index, DecodedTile<int16_t>&& tile) {
+        seen[index] = true;
+        REQUIRE(tile.samples == first.samples);
+    });
+    REQUIRE(report.tiles == 4);
+    REQUIRE(report.bytes == 4 * 1201 * 1201 * 2);
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [](bool b) { return b; }));
+
+    const size_t size = 11;
+    DemMosaic mosaic(writeMosaicTiles(size).string(), size, 64 * size * size * 2);
+    const BatchLoadReport intoMosaic = loadTilesInto(pool, mosaic, { { 34, -117 }, { 34, -116 }, { 35, -117 }, { 35, -116 }, { 0, 0 } });
+    REQUIRE(intoMosaic.tiles == 4);
+    REQUIRE(intoMosaic.mappedTiles == 4);
+    REQUIRE(intoMosaic.bytes == 0);
+    REQUIRE(mosaic.isCached(34, -116));
+    REQUIRE(mosaic.isCached(0, 0));
+    REQUIRE(mosaic.stats().misses == 0);
+
+    DemMosaic decoded(writeMosaicTiles(size).string(), size, 64 * size * size * 2, DemMosaic::Storage::Decoded);
+    const BatchLoadReport intoDecoded = loadTilesInto(pool, decoded, { { 34, -117 }, { 35, -116 } });
+    REQUIRE(intoDecoded.mappedTiles == 0);
+    REQUIRE(intoDecoded.bytes == 2 * size * size * 2);
+
+    REQUIRE_THROWS(loadTiles(pool, { paths[0], "missing.hgt" }, [](size_t, DecodedTile<int16_t>&&) {}));
+}
+
+// Three-pass getNormalizePoints (min_element, max_element, branchy emit loop)
+// that DemMaker used before the fused kernel; kept as the reference and the
+// benchmark baseline.
+static std::vector<Point> getNormalizePointsReference(const std::vector<float>& elevations, int step)
+{
+    const size_t size = static_cast<size_t>(std::lround(std::sqrt(static_cast<double>(elevations.size()))));
+    const float minElevation = *std::min_element(elevations.begin(), elevations.end());
+    const float maxElevation = *std::max_element(elevations.begin(), elevations.end());
+    const float elevationRange = maxElevation - minElevation;
+    const float offset = (size > 1) ? static_cast<float>(size - 1) / 2.0f : 1.0f;
+
+    std::vector<Point> result;
+    for (size_t y = 0; y < size; y += step) {
+        for (size_t x = 0; x < size; x += step) {
+            const float elev = elevations[y * size + x];
+            const float px = (offset == 0.0f) ? 0.0f : (static_cast<float>(x) - offset) / offset;
+            const float py = (offset == 0.0f) ? 0.0f : (static_cast<float>(y) - offset) / offset;
+            const float pz = (elevationRange == 0.0f) ? 0.0f : (elev - minElevation) / elevationRange * 2.0f - 1.0f;
+            result.emplace_back(px, py, pz);
+        }
+    }
+    return result;
+}
+
+static bool pointsNear(const std::vector<Point>& a, const std::vector<Point>& b)
+{
+    const float eps = 1e-5f;
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [eps](const Point& p, const Point& q) {
+        return std::fabs(p.x_ - q.x_) < eps && std::fabs(p.y_ - q.y_) < eps && std::fabs(p.z_ - q.z_) < eps;
+    });
+}
+
+TEST_CASE("Fused getNormalizePoints matches the three-pass reference", "[DemMaker]")
+{
+    const size_t size = 257;
+    const std::vector<float> elevations = SrtmReader(writeSyntheticHgt("normalize_257.hgt", size), size).getElevationData();
+    const std::vector<int16_t> native(elevations.begin(), elevations.end());
+
+    for (const int step : { 1, 3, 16 }) {
+        const std::vector<Point> reference = getNormalizePointsReference(elevations, step);
+        REQUIRE(pointsNear(getNormalizePoints(elevations, step), reference));
+        REQUIRE(pointsNear(getNormalizePoints(native, step), reference));
+    }
+
+    const std::vector<Point> flat = getNormalizePoints(std::vector<float>(16, 42.0f), 1);
+    REQUIRE(std::all_of(flat.begin(), flat.end(), [](const Point& p) { return p.z_ == 0.0f; }));
+}
+
+TEST_CASE("SRTM1 normalize: three-pass vs fused", "[.][benchmark][DemMaker]")
+{
+    const size_t size = 3601;
+    SrtmReader reader(writeSyntheticHgt("bench_3601.hgt", size), size);
+    const std::vector<float> elevations = reader.getElevationData();
+    const DecodedTile<int16_t> native = reader.getElevationTile<int16_t>();
+
+    BENCHMARK("three-pass reference") {
+        return getNormalizePointsReference(elevations, 1);
+    };
+    BENCHMARK("fused float") {
+        return getNormalizePoints(elevations, 1);
+    };
+    BENCHMARK("fused int16 with decode stats") {
+        return getNormalizePoints(native.samples, native.stats, 1);
+    };
+}
+
+TEST_CASE("SoA and height-only normalization match the AoS points", "[DemMaker]")
+{
+    const size_t size = 101;
+    SrtmReader reader(writeSyntheticHgt("soa_101.hgt", size), size);
+    const DecodedTile<int16_t> tile = reader.getElevationTile<int16_t>();
+
+    for (const int step : { 1, 4 }) {
+        const std::vector<Point> points = getNormalizePoints(tile.samples, tile.stats, step);
+        const PointsSoA soa = getNormalizePointsSoA(tile.samples, tile.stats, step);
+        const HeightGrid heights = getNormalizedHeights(tile.samples, step);
+
+        REQUIRE(soa.size() == points.size());
+        REQUIRE(heights.rows * heights.cols == points.size());
+        size_t mismatches = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            const size_t row = i / heights.cols, col = i % heights.cols;
+            const Point& p = points[i];
+            if (soa.x[i] != p.x_ || soa.y[i] != p.y_ || soa.z[i] != p.z_) mismatches++;
+            if (heights.x(col) != p.x_ || heights.y(row) != p.y_ || heights.at(row, col) != p.z_) mismatches++;
+        }
+        REQUIRE(mismatches == 0);
+    }
+}
+
+TEST_CASE("Row-band parallel normalization is bit-identical to serial", "[DemMaker]")
+{
+    const size_t size = 301;
+    SrtmReader reader(writeSyntheticHgt("parallel_301.hgt", size), size);
+    const std::vector<float> elevations = reader.getElevationData();
+    ThreadPool pool(4);
+
+    const auto sameBytes = [](const auto& a, const auto& b) {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+    };
+    for (const int step : { 1, 7 }) {
+        REQUIRE(sameBytes(getNormalizePoints(elevations, step, &pool), getNormalizePoints(elevations, step)));
+        const PointsSoA serial = getNormalizePointsSoA(elevations, step);
+        const PointsSoA parallel = getNormalizePointsSoA(elevations, step, &pool);
+        REQUIRE(sameBytes(parallel.x, serial.x));
+        REQUIRE(sameBytes(parallel.y, serial.y));
+        REQUIRE(sameBytes(parallel.z, serial.z));
+        REQUIRE(sameBytes(getNormalizedHeights(elevations, step, &pool).z, getNormalizedHeights(elevations, step).z));
+    }
+}
+
+TEST_CASE("SRTM1 normalize: serial vs row-band parallel", "[.][benchmark][DemMaker]")
+{
+    const size_t size = 3601;
+    const DecodedTile<int16_t> tile = SrtmReader(writeSyntheticHgt("bench_3601.hgt", size), size).getElevationTile<int16_t>();
+    ThreadPool pool;
+
+    BENCHMARK("serial") {
+        return getNormalizePoints(tile.samples, tile.stats, 1);
+    };
+    BENCHMARK("parallel, " + std::to_string(pool.size()) + " threads") {
+        return getNormalizePoints(tile.samples, tile.stats, 1, &pool);
+    };
+}
+
+TEST_CASE("Grid views normalize mapped windows without copying the tile", "[DemMaker]")
+{
+    const size_t size = 121;
+    SrtmReader reader(writeSyntheticHgt("view_121.hgt", size), size);
+    const SrtmTileView tile = reader.openTileView();
+    const GridView<HgtSample> mapped = gridView(tile);
+
+    SECTION("whole tile matches the decoded vector") {
+        const std::vector<int16_t> samples = reader.getElevationData<int16_t>();
+        REQUIRE(pointsNear(getNormalizePoints(mapped, 3), getNormalizePoints(samples, 3)));
+    }
+
+    SECTION("rectangular window matches a decoded copy of it") {
+        const size_t x0 = 10, y0 = 20, w = 61, h = 31;
+        const std::vector<int16_t> copy = reader.getWindow<int16_t>(x0, y0, w, h);
+        const GridView<HgtSample> window = mapped.window(y0, x0, h, w);
+        REQUIRE(window.at(0, 0).value() == copy[0]);
+
+        const HeightGrid fromView = getNormalizedHeights(window, 2);
+        const HeightGrid fromCopy = getNormalizedHeights(GridView<int16_t>(copy.data(), h, w), 2);
+        REQUIRE(fromView.rows == 16);
+        REQUIRE(fromView.cols == 31);
+        REQUIRE(fromView.z == fromCopy.z);
+
+        // The longer side spans [-1,1]; the shorter one is centred at the same scale.
+        const std::vector<Point> points = getNormalizePoints(window, 1);
+        REQUIRE(points.front().x_ == Catch::Approx(-1.0f));
+        REQUIRE(points.back().x_ == Catch::Approx(1.0f));
+        REQUIRE(points.front().y_ == Catch::Approx(-0.5f));
+        REQUIRE(points.back().y_ == Catch::Approx(0.5f));
+    }
+
+    REQUIRE_THROWS_AS(mapped.window(100, 0, 30, 10), std::out_of_range);
+}
+
+TEST_CASE("Adaptive simplification bounds the error with a crack-free mesh", "[DemMaker]")
+{
+    // Rolling hills with a sharp ridge, on a rectangular grid.
+    const size_t rows = 97, cols = 161;
+    std::vector<float> elevations(rows * cols);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            const double ridge = std::max(0.0, 300.0 - 40.0 * std::fabs(static_cast<double>(c) - 0.8 * static_cast<double>(r) - 40.0));
+            elevations[r * cols + c] = static_cast<float>(500.0 + 80.0 * std::sin(r * 0.09) * std::cos(c * 0.05) + ridge);
+        }
+    }
+    const GridView<float> grid(elevations.data(), rows, cols);
+    const float tolerance = 4.0f;
+    const TerrainMesh mesh = simplifyTerrain(grid, tolerance);
+    REQUIRE(mesh.maxError <= tolerance);
+    REQUIRE(mesh.vertices.size() < elevations.size() / 2);
+
+    // Rasterize the mesh back onto the grid: the triangles must tile it exactly
+    // and reproduce every sample within the tolerance.
+    const HeightGrid full = getNormalizedHeights(grid, 1);
+    const auto [lo, hi] = std::minmax_element(elevations.begin(), elevations.end());
+    const double zTolerance = tolerance * 2.0 / (*hi - *lo) + 1e-5;
+    const double cell = full.x(1) - full.x(0);
+    std::vector<int> covered(rows * cols, 0);
+    int64_t doubleArea = 0;
+    size_t flipped = 0, outOfTolerance = 0;
+    for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+        int64_t x[3], y[3];
+        double z[3];
+        for (int i = 0; i < 3; i++) {
+            const Point& p = mesh.vertices[mesh.indices[t + i]];
+            x[i] = std::lround((p.x_ - full.x(0)) / cell);
+            y[i] = std::lround((p.y_ - full.y(0)) / cell);
+            z[i] = p.z_;
+        }
+        const int64_t det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (det <= 0) flipped++;
+        doubleArea += det;
+        for (int64_t r = std::min({ y[0], y[1], y[2] }); r <= std::max({ y[0], y[1], y[2] }); r++) {
+            for (int64_t c = std::min({ x[0], x[1], x[2] }); c <= std::max({ x[0], x[1], x[2] }); c++) {
+                const int64_t a = (c - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (r - y[0]);
+                const int64_t b = (x[1] - x[0]) * (r - y[0]) - (c - x[0]) * (y[1] - y[0]);
+                if (a < 0 || b < 0 || a + b > det) continue;
+                covered[r * cols + c] = 1;
+                const double zi = z[0] + (a * (z[1] - z[0]) + b * (z[2] - z[0])) / static_cast<double>(det);
+                if (std::fabs(zi - full.at(r, c)) > zTolerance) outOfTolerance++;
+            }
+        }
+    }
+    REQUIRE(flipped == 0);
+    REQUIRE(doubleArea == static_cast<int64_t>(2 * (rows - 1) * (cols - 1)));
+    REQUIRE(std::count(covered.begin(), covered.end(), 0) == 0);
+    REQUIRE(outOfTolerance == 0);
+
+    ThreadPool pool(4);
+    const TerrainMesh parallel = simplifyTerrain(grid, tolerance, &pool);
+    REQUIRE(parallel.indices == mesh.indices);
+    REQUIRE(pointsNear(parallel.vertices, mesh.vertices));
+}
+
+TEST_CASE("Flat terrain simplifies to a few percent of its samples", "[DemMaker]")
+{
+    const size_t size = 121;
+    SrtmReader reader(writeSyntheticHgt("plane_121.hgt", size), size);
+    // The synthetic tile is a plane: two triangles cover it exactly.
+    const TerrainMesh plane = simplifyTerrain(gridView(reader.openTileView()), 0.5f);
+    REQUIRE(plane.vertices.size() == 4);
+    REQUIRE(plane.triangleCount() == 2);
+
+    // Desert: metre-scale noise with a single dune.
+    std::vector<int16_t> desert(size * size);
+    for (size_t r = 0; r < size; r++) {
+        for (size_t c = 0; c < size; c++) {
+            const double d2 = (r - 30.0) * (r - 30.0) + (c - 90.0) * (c - 90.0);
+            desert[r * size + c] = static_cast<int16_t>(200 + (r * 31 + c * 17) % 3 + std::lround(25.0 * std::exp(-d2 / 60.0)));
+        }
+    }
+    const TerrainMesh mesh = simplifyTerrain(desert, 3.0f);
+    REQUIRE(mesh.maxError <= 3.0f);
+    REQUIRE(mesh.vertices.size() < desert.size() / 20);
+}
+
+TEST_CASE("DemPyramid serves power-of-two levels of detail", "[DemMaker]")
+{
+    const size_t rows = 75, cols = 101;
+    std::vector<int16_t> samples(rows * cols);
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = static_cast<int16_t>((i * 37) % 1000);
+    samples[5 * cols + 9] = kHgtVoid;
+    const GridView<int16_t> grid(samples.data(), rows, cols);
+    ThreadPool pool(4);
+    const DemPyramid pyramid(grid, &pool);
+
+    REQUIRE(pyramid.levelCount() == 8);
+    REQUIRE(pyramid.level(7).rows == 1);
+    REQUIRE(pyramid.level(7).cols == 1);
+    size_t coarseCells = 0;
+    for (size_t k = 1; k < pyramid.levelCount(); k++) coarseCells += pyramid.level(k).mean.size();
+    REQUIRE(coarseCells < samples.size() / 3 + pyramid.levelCount() * (rows + cols));
+
+    // A level-3 cell against its 8x8 block of samples, one of them void.
+    const PyramidLevel& level3 = pyramid.level(3);
+    float lo = 1e9f, hi = -1e9f, sum = 0.0f;
+    uint32_t count = 0;
+    for (size_t r = 0; r < 8; r++) {
+        for (size_t c = 8; c < 16; c++) {
+            const int16_t v = grid.at(r, c);
+            if (v == kHgtVoid) continue;
+            lo = std::min(lo, float(v));
+            hi = std::max(hi, float(v));
+            sum += v;
+            count++;
+        }
+    }
+    REQUIRE(level3.validCount[1] == 63);
+    REQUIRE(level3.minView().at(0, 1) == lo);
+    REQUIRE(level3.maxView().at(0, 1) == hi);
+    REQUIRE(level3.meanView().at(0, 1) == Catch::Approx(sum / count));
+
+    // Level k has the layout of step 2^k; level 0 is exactly step 1.
+    REQUIRE(getNormalizedHeights(pyramid, 0).z == getNormalizedHeights(grid, 1).z);
+    for (const size_t k : { 1, 2, 4 }) {
+        const HeightGrid lod = getNormalizedHeights(pyramid, k);
+        const HeightGrid stepped = getNormalizedHeights(grid, 1 << k);
+        REQUIRE(lod.rows == stepped.rows);
+        REQUIRE(lod.cols == stepped.cols);
+        REQUIRE(lod.x(lod.cols - 1) == stepped.x(stepped.cols - 1));
+        REQUIRE(lod.y(lod.rows - 1) == stepped.y(stepped.rows - 1));
+        REQUIRE(pointsNear(getNormalizePoints(pyramid, k), getNormalizePoints(pyramid, k, &pool)));
+    }
+    REQUIRE_THROWS_AS(getNormalizedHeights(pyramid, 8), std::out_of_range);
+}
+
+TEST_CASE("HeightSampler batch kernels match the scalar reference", "[HeightSampler]")
+{
+    const size_t rows = 40, cols = 57;
+    std::vector<float> elevations(rows * cols);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            elevations[r * cols + c] = static_cast<float>(100.0 * std::sin(r * 0.3) + 3.0 * c + (r * c) % 7);
+        }
+    }
+    elevations[10 * cols + 20] = kHgtVoid;
+    VoidMask voids(elevations.size());
+    voids.set(30 * cols + 40);
+    const HeightSampler sampler(GridView<float>(elevations.data(), rows, cols), &voids);
+
+    // Queries across the grid, its borders and beyond, ending in a scalar tail.
+    std::vector<float> qx, qy;
+    for (int i = 0; i < 2003; i++) {
+        qx.push_back(-3.0f + static_cast<float>((i * 7919) % 6300) / 100.0f);
+        qy.push_back(-2.0f + static_cast<float>((i * 104729) % 4400) / 100.0f);
+    }
+    qx.insert(qx.end(), { 20.0f, 20.5f, 40.0f, 40.25f });
+    qy.insert(qy.end(), { 10.0f, 10.0f, 30.0f, 30.0f });
+    std::vector<float> batch(qx.size()), reference(qx.size());
+
+    for (const auto filter : { HeightSampler::Filter::Bilinear, HeightSampler::Filter::Bicubic }) {
+        sampler.sample(qx.data(), qy.data(), batch.data(), qx.size(), filter);
+        sampler.sampleScalar(qx.data(), qy.data(), reference.data(), qx.size(), filter);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < qx.size(); i++) {
+            if (std::fabs(batch[i] - reference[i]) > 1e-3f * std::max(1.0f, std::fabs(reference[i]))) mismatches++;
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+    using Filter = HeightSampler::Filter;
+    // Samples are reproduced exactly at integer coordinates.
+    REQUIRE(sampler.sample(5.0f, 7.0f) == elevations[7 * cols + 5]);
+    REQUIRE(sampler.sample(5.0f, 7.0f, Filter::Bicubic) == Catch::Approx(elevations[7 * cols + 5]));
+    // Outside queries clamp to the border.
+    REQUIRE(sampler.sample(-10.0f, 100.0f) == elevations[(rows - 1) * cols]);
+    // Voids (by value or by mask) are skipped; exactly on one there is nothing left.
+    REQUIRE(sampler.sample(20.0f, 10.0f) == kHgtVoid);
+    REQUIRE(sampler.sample(40.0f, 30.0f) == kHgtVoid);
+    REQUIRE(sampler.sample(20.5f, 10.0f) == elevations[10 * cols + 21]);
+    REQUIRE(sampler.sample(40.25f, 30.0f, Filter::Bicubic) == elevations[30 * cols + 41]);
+}
+
+TEST_CASE("Bicubic sampling reproduces linear slopes", "[HeightSampler]")
+{
+    const size_t size = 16;
+    std::vector<float> plane(size * size);
+    for (size_t r = 0; r < size; r++) {
+        for (size_t c = 0; c < size; c++) plane[r * size + c] = 2.0f * c - 3.0f * r + 50.0f;
+    }
+    const HeightSampler sampler(GridView<float>::square(plane));
+    const float x[] = { 3.25f, 7.5f, 11.75f }, y[] = { 4.5f, 8.125f, 2.875f };
+    float h[3];
+    sampler.sample(x, y, h, 3, HeightSampler::Filter::Bicubic);
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(h[i] == Catch::Approx(2.0f * x[i] - 3.0f * y[i] + 50.0f));
+    }
+}
+
+// Rolling hills on the order of a few hundred metres, for ray casting.
+static float hillElevation(size_t row, size_t col)
+{
+    return static_cast<float>(800.0 + 300.0 * std::sin(row * 0.013) * std::cos(col * 0.017) + 40.0 * std::sin(row * 0.11 + col * 0.07));
+}
+
+// hillElevation sampled on a 'size x size' grid.
+static std::vector<float> hillGrid(size_t size)
+{
+    std::vector<float> elevations(size * size);
+    for (size_t r = 0; r < size; r++) {
+        for (size_t c = 0; c < size; c++) elevations[r * size + c] = hillElevation(r, c);
+    }
+    return elevations;
+}
+
+// A LidarSensor with square 'cell' metre cells over the grid it owns. The
+// sensor points into 'elevations', so the pair is never copied or moved.
+struct HillSensor {
+    std::vector<float> elevations;
+    LidarSensor sensor;
+
+    HillSensor(std::vector<float> grid, float cell)
+        : elevations(std::move(grid)), sensor(GridView<float>::square(elevations), cell, cell) {
+    }
+    HillSensor(const HillSensor&) = delete;
+    HillSensor& operator=(const HillSensor&) = delete;
+};
+
+static HillSensor makeHillSensor(size_t size, float cell)
+{
+    return HillSensor(hillGrid(size), cell);
+}
+
+// First crossing of the bilinear surface found by marching in small steps.
+static float marchRange(const HeightSampler& sampler, size_t rows, float cell, const Ray& ray, float maxRange, float step)
+{
+    const float len = std::sqrt(ray.dx * ray.dx + ray.dy * ray.dy + ray.dz * ray.dz);
+    for (float t = 0.0f; t <= maxRange; t += step) {
+        const float x = ray.ox + ray.dx / len * t, y = ray.oy + ray.dy / len * t, z = ray.oz + ray.dz / len * t;
+        const float col = x / cell, row = static_cast<float>(rows - 1) - y / cell;
+        if (col < 0.0f || row < 0.0f || col > static_cast<float>(rows - 1) || row > static_cast<float>(rows - 1)) continue;
+        if (z <= sampler.sample(col, row)) return t;
+    }
+    return -1.0f;
+}
+
+TEST_CASE("MaxMipmap bounds every block of cells from above", "[MaxMipmap]")
+{
+    const size_t rows = 150, cols = 203;
+    std::vector<float> elevations(rows * cols);
+    for (size_t i = 0; i < elevations.size(); i++) elevations[i] = static_cast<float>((i * 7907) % 3001) - 100.5f;
+    for (size_t c = 0; c < cols; c++) elevations[77 * cols + c] = kHgtVoid;
+    const GridView<float> grid(elevations.data(), rows, cols);
+    ThreadPool pool(4);
+    const MaxMipmap mipmap(grid, &pool);
+    const MaxMipmap serial(grid);
+
+    REQUIRE(mipmap.levelCount() == 9);
+    REQUIRE(mipmap.rows(8) == 1);
+    REQUIRE(mipmap.cols(8) == 1);
+    // About a third of the int16 grid once the levels fill whole bricks.
+    const std::vector<float> aligned = hillGrid(1025);
+    REQUIRE(MaxMipmap(GridView<float>::square(aligned)).memoryBytes() <= 0.34 * aligned.size() * sizeof(int16_t));
+
+    // Every block against a brute-force max over its samples.
+    size_t mismatches = 0;
+    for (size_t k = 1; k < mipmap.levelCount(); k++) {
+        const size_t side = size_t(1) << k;
+        for (size_t r = 0; r < mipmap.rows(k); r++) {
+            for (size_t c = 0; c < mipmap.cols(k); c++) {
+                float m = kHgtVoid;
+                for (size_t sr = r * side; sr <= std::min((r + 1) * side, rows - 1); sr++) {
+                    for (size_t sc = c * side; sc <= std::min((c + 1) * side, cols - 1); sc++) m = std::max(m, grid.at(sr, sc));
+                }
+                if (mipmap.blockMax(k, r, c) != static_cast<int16_t>(std::ceil(m))) mismatches++;
+                if (serial.blockMax(k, r, c) != mipmap.blockMax(k, r, c)) mismatches++;
+            }
+        }
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(mipmap.below(8, 0, 0, 3000.0f));
+    REQUIRE_FALSE(mipmap.below(8, 0, 0, 2800.0f));
+}
+
+TEST_CASE("Surface rasters recover the orientation of a plane", "[TerrainSurface]")
+{
+    // Rises 0.6 per metre eastwards and 0.2 per metre northwards (row 0 is north).
+    const size_t rows = 20, cols = 27;
+    const float dx = 30.0f, dy = 20.0f;
+    std::vector<int16_t> samples(rows * cols);
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) samples[r * cols + c] = static_cast<int16_t>(18 * c - 4 * r + 1000);
+    }
+    SurfaceOutputs outputs;
+    outputs.packedNormals = true;
+    const SurfaceRaster s = computeSurface(GridView<int16_t>(samples.data(), rows, cols), dx, dy, outputs);
+
+    const float len = std::sqrt(0.6f * 0.6f + 0.2f * 0.2f + 1.0f);
+    const float slope = std::atan(std::sqrt(0.6f * 0.6f + 0.2f * 0.2f));
+    const float aspect = std::atan2(-0.6f, -0.2f) + 2.0f * 3.14159265f; // downhill: west-south-west
+    size_t wrong = 0;
+    for (size_t r = 1; r + 1 < rows; r++) {
+        for (size_t c = 1; c + 1 < cols; c++) {
+            const size_t i = r * cols + c;
+            float x, y, z;
+            unpackNormal(&s.packedNormals[2 * i], x, y, z);
+            if (std::fabs(s.nx[i] + 0.6f / len) > 1e-5f || std::fabs(s.ny[i] + 0.2f / len) > 1e-5f || std::fabs(s.nz[i] - 1.0f / len) > 1e-5f) wrong++;
+            if (std::fabs(s.slope[i] - slope) > 1e-4f || std::fabs(s.aspect[i] - aspect) > 1e-4f) wrong++;
+            if (std::fabs(x - s.nx[i]) > 1e-3f || std::fabs(y - s.ny[i]) > 1e-3f || std::fabs(z - s.nz[i]) > 1e-3f) wrong++;
+        }
+    }
+    REQUIRE(wrong == 0);
+
+    int16_t packed[2];
+    float x, y, z;
+    packNormal(0.48f, -0.6f, -0.64f, packed);
+    unpackNormal(packed, x, y, z);
+    REQUIRE(x == Catch::Approx(0.48f).margin(1e-3));
+    REQUIRE(y == Catch::Approx(-0.6f).margin(1e-3));
+    REQUIRE(z == Catch::Approx(-0.64f).margin(1e-3));
+}
+
+TEST_CASE("Surface kernel matches the scalar reference and streams in bands", "[TerrainSurface]")
+{
+    const size_t size = 121;
+    SrtmReader reader(writeSyntheticHgt("surface_121.hgt", size), size);
+    std::vector<float> elevations = reader.getElevationData();
+    for (size_t i = 0; i < elevations.size(); i++) elevations[i] += static_cast<float>((i * 7919) % 53);
+    elevations[40 * size + 50] = kHgtVoid;
+    const GridView<float> grid = GridView<float>::square(elevations);
+    SurfaceOutputs outputs;
+    outputs.packedNormals = true;
+
+    const size_t r0 = 10, c0 = 3, h = 64, w = 101;
+    ThreadPool pool(4);
+    const SurfaceRaster fast = computeSurface(grid, r0, c0, h, w, 30.0f, 30.0f, outputs, &pool);
+    const SurfaceRaster reference = computeSurfaceScalar(grid, r0, c0, h, w, 30.0f, 30.0f, outputs);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < fast.cellCount(); i++) {
+        const float da = std::fabs(fast.aspect[i] - reference.aspect[i]);
+        if (std::fabs(fast.nx[i] - reference.nx[i]) > 1e-5f || std::fabs(fast.nz[i] - reference.nz[i]) > 1e-5f) mismatches++;
+        if (std::fabs(fast.slope[i] - reference.slope[i]) > 1e-4f || std::min(da, 6.2831853f - da) > 1e-4f) mismatches++;
+        if (std::abs(fast.packedNormals[2 * i] - reference.packedNormals[2 * i]) > 1) mismatches++;
+    }
+    REQUIRE(mismatches == 0);
+    // The void cell is flat.
+    REQUIRE(fast.aspect[(40 - r0) * w + (50 - c0)] == -1.0f);
+
+    // Bands of 16 rows read their neighbours from the grid, so they join seamlessly.
+    std::vector<float> streamed;
+    for (size_t b = 0; b < h; b += 16) {
+        const SurfaceRaster band = computeSurface(grid, r0 + b, c0, 16, w, 30.0f, 30.0f);
+        streamed.insert(streamed.end(), band.slope.begin(), band.slope.end());
+    }
+    REQUIRE(streamed == fast.slope);
+}
+
+TEST_CASE("LidarSensor finds the first bilinear surface crossing", "[LidarSensor]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const GridView<float> grid = GridView<float>::square(hill.elevations);
+    const HeightSampler sampler(grid);
+
+    // A fan of slanted rays from above, some grazing, some leaving the grid.
+    size_t wrong = 0, hits = 0;
+    for (int i = 0; i < 200; i++) {
+        const float angle = 0.0314159f * i;
+        const Ray ray{ 4500.0f, 4500.0f, 1500.0f, std::cos(angle), std::sin(angle), -0.15f - 0.004f * (i % 50) };
+        const LidarReturn ret = sensor.castRay(ray);
+        const float expected = marchRange(sampler, size, cell, ray, 20000.0f, 0.05f);
+        if (ret.hit != (expected >= 0.0f)) {
+            wrong++;
+            continue;
+        }
+        if (!ret.hit) continue;
+        hits++;
+        if (std::fabs(ret.range - expected) > 0.1f) wrong++;
+        // The hit lies on the surface, inside the reported cell.
+        const float col = ret.x / cell, row = static_cast<float>(size - 1) - ret.y / cell;
+        if (std::fabs(ret.z - sampler.sample(col, row)) > 0.01f) wrong++;
+        const bool onCellEdge = std::fabs(col - std::round(col)) < 1e-3f || std::fabs(row - std::round(row)) < 1e-3f;
+        if (!onCellEdge && ret.cell != static_cast<uint32_t>(std::floor(row)) * size + static_cast<uint32_t>(std::floor(col))) wrong++;
+    }
+    REQUIRE(wrong == 0);
+    REQUIRE(hits > 150);
+
+    // Straight down onto a sample, straight up, and past the grid.
+    const LidarReturn down = sensor.castRay({ 30.0f * 7, 30.0f * 12, 5000.0f, 0.0f, 0.0f, -1.0f });
+    REQUIRE(down.hit);
+    REQUIRE(down.z == Catch::Approx(grid.at(size - 1 - 12, 7)).margin(1e-3));
+    REQUIRE_FALSE(sensor.castRay({ 4500.0f, 4500.0f, 2000.0f, 0.0f, 0.0f, 1.0f }).hit);
+    REQUIRE_FALSE(sensor.castRay({ -100.0f, 4500.0f, 2000.0f, -1.0f, 0.0f, -0.1f }).hit);
+}
+
+TEST_CASE("Ray packets agree with single rays", "[LidarSensor]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    std::vector<float> elevations = hillGrid(size);
+    elevations[150 * size + 150] = static_cast<float>(kHgtVoid);
+    const HillSensor hill(std::move(elevations), cell);
+    const LidarSensor& sensor = hill.sensor;
+
+    // Coherent fans, plus lanes that start outside, point up or have no direction.
+    const size_t count = 64;
+    std::vector<RayPacket> packets(count);
+    std::vector<Ray> rays(count * 8);
+    for (size_t i = 0; i < rays.size(); i++) {
+        const float angle = 0.0123f * static_cast<float>(i);
+        rays[i] = { 4500.0f, 4500.0f, 1500.0f, std::cos(angle), std::sin(angle), -0.1f - 0.002f * (i % 97) };
+        if (i % 29 == 3) rays[i] = { -500.0f, 4500.0f, 1500.0f, -1.0f, 0.0f, -0.1f };
+        if (i % 31 == 5) rays[i].dz = 0.5f;
+        if (i % 37 == 7) rays[i] = { 4500.0f, 4500.0f, 1500.0f, 0.0f, 0.0f, 0.0f };
+        if (i % 41 == 9) rays[i] = { 4500.0f, 4500.0f, 1500.0f, 0.0f, 0.0f, -1.0f };
+        RayPacket& packet = packets[i / 8];
+        const size_t lane = i % 8;
+        packet.ox[lane] = rays[i].ox;
+        packet.oy[lane] = rays[i].oy;
+        packet.oz[lane] = rays[i].oz;
+        packet.dx[lane] = rays[i].dx;
+        packet.dy[lane] = rays[i].dy;
+        packet.dz[lane] = rays[i].dz;
+    }
+    std::vector<LidarReturn> returns(rays.size());
+    sensor.castPackets(packets.data(), count, returns.data());
+
+    size_t wrong = 0, hits = 0;
+    for (size_t i = 0; i < rays.size(); i++) {
+        const LidarReturn expected = sensor.castRay(rays[i]);
+        if (returns[i].hit != expected.hit) {
+            wrong++;
+            continue;
+        }
+        if (!expected.hit) continue;
+        hits++;
+        if (std::fabs(returns[i].range - expected.range) > 1e-2f || returns[i].cell != expected.cell) wrong++;
+    }
+    REQUIRE(wrong == 0);
+    REQUIRE(hits > rays.size() / 2);
+}
+
+TEST_CASE("Height lookups read int16 and mapped samples in place", "[HeightSampler][LidarSensor]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    std::vector<int16_t> native(size * size);
+    std::vector<float> asFloat(size * size);
+    std::vector<HgtSample> mapped(size * size);
+    for (size_t i = 0; i < native.size(); i++) {
+        native[i] = static_cast<int16_t>(std::lround(hillElevation(i / size, i % size)));
+        if (i == 150 * size + 150) native[i] = kHgtVoid;
+        asFloat[i] = native[i];
+        const uint16_t u = static_cast<uint16_t>(native[i]);
+        mapped[i] = HgtSample{ static_cast<uint8_t>(u >> 8), static_cast<uint8_t>(u & 0xFF) };
+    }
+
+    // Batch queries, including the grid's final sample, agree across storages.
+    std::vector<float> qx, qy;
+    for (int i = 0; i < 1003; i++) {
+        qx.push_back(static_cast<float>((i * 7919) % 30500) / 100.0f);
+        qy.push_back(static_cast<float>((i * 104729) % 30500) / 100.0f);
+    }
+    qx.insert(qx.end(), 8, static_cast<float>(size - 1));
+    qy.insert(qy.end(), 8, static_cast<float>(size - 1));
+    const HeightSampler fromFloat(GridView<float>::square(asFloat));
+    const HeightSampler fromNative(GridView<int16_t>::square(native));
+    const HeightSampler fromMapped(GridView<HgtSample>(mapped.data(), size, size));
+    std::vector<float> expected(qx.size()), expectedScalar(qx.size()), h(qx.size());
+    for (const auto filter : { HeightSampler::Filter::Bilinear, HeightSampler::Filter::Bicubic }) {
+        fromFloat.sample(qx.data(), qy.data(), expected.data(), qx.size(), filter);
+        fromFloat.sampleScalar(qx.data(), qy.data(), expectedScalar.data(), qx.size(), filter);
+        for (const HeightSampler* sampler : { &fromNative, &fromMapped }) {
+            sampler->sample(qx.data(), qy.data(), h.data(), qx.size(), filter);
+            REQUIRE(h == expected);
+            sampler->sampleScalar(qx.data(), qy.data(), h.data(), qx.size(), filter);
+            REQUIRE(h == expectedScalar);
+        }
+    }
+    REQUIRE(fromMapped.sample(static_cast<float>(size - 1), static_cast<float>(size - 1)) == native.back());
+
+    const LidarSensor floatSensor(GridView<float>::square(asFloat), cell, cell);
+    const LidarSensor nativeSensor(GridView<int16_t>::square(native), cell, cell);
+    const LidarSensor mappedSensor(GridView<HgtSample>(mapped.data(), size, size), cell, cell);
+    size_t wrong = 0;
+    for (int i = 0; i < 200; i++) {
+        const float angle = 0.0314159f * i;
+        const Ray ray{ 4500.0f, 4500.0f, 1500.0f, std::cos(angle), std::sin(angle), -0.15f - 0.004f * (i % 50) };
+        const LidarReturn ref = floatSensor.castRay(ray);
+        for (const LidarSensor* sensor : { &nativeSensor, &mappedSensor }) {
+            const LidarReturn ret = sensor->castRay(ray);
+            if (ret.hit != ref.hit || ret.range != ref.range || ret.cell != ref.cell) wrong++;
+        }
+    }
+    REQUIRE(wrong == 0);
+}
+
+TEST_CASE("SRTM1 ray casting throughput", "[.][benchmark][LidarSensor]")
+{
+    const size_t size = 3601;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+
+    // A +-20 degree cross-track swath from 2000 m above the hills.
+    const size_t n = 1 << 20;
+    std::vector<Ray> rays(n);
+    for (size_t i = 0; i < n; i++) {
+        const float along = 1000.0f + 100000.0f * static_cast<float>(i) / n;
+        const float angle = 0.35f * std::sin(0.01f * static_cast<float>(i));
+        rays[i] = { along, 54000.0f, 3000.0f, 0.0f, std::sin(angle), -std::cos(angle) };
+    }
+    std::vector<LidarReturn> returns(n);
+
+    std::vector<RayPacket> packets(n / 8);
+    for (size_t i = 0; i < n; i++) {
+        RayPacket& packet = packets[i / 8];
+        packet.ox[i % 8] = rays[i].ox;
+        packet.oy[i % 8] = rays[i].oy;
+        packet.oz[i % 8] = rays[i].oz;
+        packet.dx[i % 8] = rays[i].dx;
+        packet.dy[i % 8] = rays[i].dy;
+        packet.dz[i % 8] = rays[i].dz;
+    }
+
+    BENCHMARK("1M rays") {
+        sensor.castRays(rays.data(), returns.data(), n);
+        return returns[n / 2].range;
+    };
+    BENCHMARK("1M rays, 8-wide packets") {
+        sensor.castPackets(packets.data(), packets.size(), returns.data());
+        return returns[n / 2].range;
+    };
+}
+
+TEST_CASE("Scan patterns tabulate their closed forms", "[ScanPattern]")
+{
+    const size_t n = 1000;
+    std::vector<float> x(n), y(n), z(n);
+    size_t wrong = 0;
+
+    // Zig-zag: out across the field of view and back, then repeat.
+    const float fov = 0.6f;
+    const ZigZagPattern zigZag(fov, 100);
+    REQUIRE(zigZag.period() == 200);
+    zigZag.generate(150, n, x.data(), y.data(), z.data());
+    for (size_t i = 0; i < n; i++) {
+        const size_t k = (150 + i) % 200, line = k < 100 ? k : 199 - k;
+        const float angle = fov * ((line + 0.5f) / 100.0f - 0.5f);
+        if (x[i] != 0.0f || std::fabs(y[i] - std::sin(angle)) > 1e-6f || std::fabs(z[i] + std::cos(angle)) > 1e-6f) wrong++;
+    }
+
+    // Polygon: every line sweeps the same way.
+    const PolygonPattern polygon(fov, 64);
+    polygon.generate(10, n, x.data(), y.data(), z.data());
+    for (size_t i = 0; i < n; i++) {
+        const float angle = fov * (((10 + i) % 64 + 0.5f) / 64.0f - 0.5f);
+        if (std::fabs(y[i] - std::sin(angle)) > 1e-6f || std::fabs(z[i] + std::cos(angle)) > 1e-6f) wrong++;
+    }
+
+    // Palmer: unit vectors on an elliptical cone, forward at the start of a
+    // revolution and to the left a quarter later.
+    const PalmerPattern palmer(0.2f, 0.3f, 400);
+    palmer.generate(0, n, x.data(), y.data(), z.data());
+    for (size_t i = 0; i < n; i++) {
+        if (std::fabs(x[i] * x[i] + y[i] * y[i] + z[i] * z[i] - 1.0f) > 1e-5f) wrong++;
+        const float a = -x[i] / z[i] / std::tan(0.2f), b = -y[i] / z[i] / std::tan(0.3f);
+        if (std::fabs(a * a + b * b - 1.0f) > 1e-4f) wrong++;
+    }
+    REQUIRE(x[0] > 0.0f);
+    REQUIRE(std::fabs(y[0]) < 1e-6f);
+    REQUIRE(y[100] > 0.0f);
+    REQUIRE(std::fabs(x[100]) < 1e-6f);
+
+    // Multi-beam: all beams at one azimuth, then the next azimuth.
+    const std::vector<float> elevations = { -0.3f, -0.2f, -0.1f, 0.0f, 0.1f };
+    const MultiBeamPattern multiBeam(elevations, 360);
+    REQUIRE(multiBeam.period() == 1800);
+    multiBeam.generate(1797, n, x.data(), y.data(), z.data());
+    for (size_t i = 0; i < n; i++) {
+        const size_t pulse = (1797 + i) % 1800;
+        const float e = elevations[pulse % 5], azimuth = 2.0f * 3.14159265f * static_cast<float>(pulse / 5) / 360.0f;
+        if (std::fabs(x[i] - std::cos(e) * std::cos(azimuth)) > 1e-5f || std::fabs(y[i] - std::cos(e) * std::sin(azimuth)) > 1e-5f
+            || std::fabs(z[i] - std::sin(e)) > 1e-6f) {
+            wrong++;
+        }
+    }
+    REQUIRE(wrong == 0);
+
+    REQUIRE_THROWS_AS(ZigZagPattern(fov, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(PalmerPattern(2.0f, 0.1f, 100), std::invalid_argument);
+    REQUIRE_THROWS_AS(MultiBeamPattern({}, 100), std::invalid_argument);
+}
+
+TEST_CASE("Scanning a pattern matches casting its rays one by one", "[ScanPattern][LidarSensor]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+
+    // Flying north-east across the grid, with a pulse count that leaves a
+    // short last packet.
+    const ZigZagPattern pattern(1.0f, 90);
+    const Platform platform{ 1000.0f, 1500.0f, 2500.0f, 0.3f, 0.3f, 0.0f, 0.7853982f };
+    const size_t count = 10003;
+    const uint64_t first = 17;
+    std::vector<LidarReturn> returns(count);
+    sensor.scan(pattern, platform, first, count, returns.data());
+
+    std::vector<float> x(count), y(count), z(count);
+    pattern.generate(first, count, x.data(), y.data(), z.data());
+    size_t wrong = 0, hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        const float c = std::cos(platform.heading), s = std::sin(platform.heading), t = static_cast<float>(i);
+        const Ray ray{ platform.x + platform.vx * t, platform.y + platform.vy * t, platform.z, c * x[i] - s * y[i], s * x[i] + c * y[i], z[i] };
+        const LidarReturn expected = sensor.castRay(ray);
+        if (returns[i].hit != expected.hit || std::fabs(returns[i].range - expected.range) > 1e-2f) wrong++;
+        if (expected.hit) hits++;
+    }
+    REQUIRE(wrong == 0);
+    REQUIRE(hits == count);
+}
+
+TEST_CASE("Work-stealing loops visit every item once", "[ThreadPool]")
+{
+    ThreadPool pool(4);
+    const size_t count = 1000;
+    std::vector<std::atomic<int>> visits(count);
+    std::vector<std::atomic<int>> perWorker(pool.size() + 1);
+    // The first items are much slower, so their owner's run gets stolen.
+    pool.stealingFor(count, [&](size_t i, size_t worker) {
+        if (i < 50) std::this_thread::sleep_for(std::chrono::microseconds(500));
+        visits[i]++;
+        perWorker[worker]++;
+    });
+    REQUIRE(std::all_of(visits.begin(), visits.end(), [](const std::atomic<int>& v) { return v == 1; }));
+    int total = 0;
+    for (auto& n : perWorker) total += n;
+    REQUIRE(total == static_cast<int>(count));
+    REQUIRE_THROWS_AS(pool.stealingFor(10, [](size_t i, size_t) { if (i == 7) throw std::runtime_error("slice failed"); }), std::runtime_error);
+    REQUIRE_THROWS_AS(pool.stealingFor(size_t(1) << 32, [](size_t, size_t) {}), std::invalid_argument);
+}
+
+TEST_CASE("Pulse simulation is independent of the thread count", "[PulseSimulator]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const PalmerPattern pattern(0.26f, 0.26f, 1000);
+    const FlightLine line{ Point(1000.0f, 1000.0f, 2500.0f), Point(8000.0f, 7000.0f, 2500.0f), 60.0f, 1000.0 };
+
+    // Small slices so that many of them are shared out and stolen.
+    const PulseSimulator simulator(sensor, 2000.0, 777);
+    const uint64_t pulses = simulator.pulseCount(line);
+    REQUIRE(pulses == static_cast<uint64_t>(std::sqrt(7000.0 * 7000.0 + 6000.0 * 6000.0) / 60.0 * 2000.0) + 1);
+
+    const std::vector<PulseReturn> serial = simulator.simulate(pattern, line);
+    ThreadPool pool(4);
+    const std::vector<PulseReturn> parallel = simulator.simulate(pattern, line, &pool);
+    REQUIRE(serial.size() > pulses * 9 / 10);
+    REQUIRE(parallel.size() == serial.size());
+    REQUIRE(std::memcmp(parallel.data(), serial.data(), serial.size() * sizeof(PulseReturn)) == 0);
+
+    size_t unordered = 0;
+    for (size_t i = 1; i < serial.size(); i++) {
+        if (!(serial[i].time > serial[i - 1].time) || serial[i].pulse <= serial[i - 1].pulse) unordered++;
+    }
+    REQUIRE(unordered == 0);
+    REQUIRE(serial.front().time >= 1000.0);
+
+    // A pulse cast by hand from the same place lands in the same spot.
+    const PulseReturn& probe = serial[serial.size() / 2];
+    const double along = 60.0 / 2000.0 * static_cast<double>(probe.pulse) / std::sqrt(7000.0 * 7000.0 + 6000.0 * 6000.0);
+    std::vector<float> x(1), y(1), z(1);
+    pattern.generate(probe.pulse, 1, x.data(), y.data(), z.data());
+    const float heading = std::atan2(6000.0f, 7000.0f);
+    const Ray ray{ static_cast<float>(1000.0 + 7000.0 * along), static_cast<float>(1000.0 + 6000.0 * along), 2500.0f,
+        std::cos(heading) * x[0] - std::sin(heading) * y[0], std::sin(heading) * x[0] + std::cos(heading) * y[0], z[0] };
+    REQUIRE(sensor.castRay(ray).range == Catch::Approx(probe.range).margin(0.05));
+}
+
+TEST_CASE("Pulse simulation: serial vs work-stealing slices", "[.][benchmark][PulseSimulator]")
+{
+    const size_t size = 3601;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const ZigZagPattern pattern(0.7f, 500);
+    // Two seconds of a 500 kHz sensor: 1M pulses.
+    const FlightLine line{ Point(5000.0f, 54000.0f, 3000.0f), Point(5120.0f, 54000.0f, 3000.0f), 60.0f };
+    const PulseSimulator simulator(sensor, 500000.0);
+    ThreadPool pool;
+
+    BENCHMARK("serial") {
+        return simulator.simulate(pattern, line).size();
+    };
+    BENCHMARK("work stealing, " + std::to_string(pool.size()) + " threads") {
+        return simulator.simulate(pattern, line, &pool).size();
+    };
+}
+
+TEST_CASE("PhiloxRng is a pure function of seed, index and stream", "[PhiloxRng]")
+{
+    // Known-answer vector of Philox4x32-10 for a zero key and counter.
+    const PhiloxRng::Block zero = PhiloxRng(0).block(0, 0);
+    REQUIRE(zero == PhiloxRng::Block{ 0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u });
+
+    // Batches straddling a carry into the high counter word match the
+    // single-value calls bit for bit, on the dispatched and scalar paths.
+    const PhiloxRng rng(0x123456789abcdefull);
+    const uint64_t first = 0xfffffff0ull;
+    const size_t n = 1003;
+    std::vector<float> u(n), uScalar(n), g(n), gScalar(n);
+    rng.uniform(first, n, 7, u.data());
+    rng.uniformScalar(first, n, 7, uScalar.data());
+    rng.normal(first, n, 7, g.data());
+    rng.normalScalar(first, n, 7, gScalar.data());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (u[i] != rng.uniform(first + i, 7) || g[i] != rng.normal(first + i, 7)) mismatches++;
+        if (std::memcmp(&u[i], &uScalar[i], sizeof(float)) != 0 || std::memcmp(&g[i], &gScalar[i], sizeof(float)) != 0) mismatches++;
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(rng.uniform(5, 1) != rng.uniform(5, 2));
+    REQUIRE(rng.uniform(5, 1) != PhiloxRng(1).uniform(5, 1));
+
+    // Distribution moments.
+    const size_t m = 1 << 18;
+    std::vector<float> values(m);
+    rng.uniform(0, m, 1, values.data());
+    REQUIRE(*std::min_element(values.begin(), values.end()) >= 0.0f);
+    REQUIRE(*std::max_element(values.begin(), values.end()) < 1.0f);
+    double sum = 0.0;
+    for (float v : values) sum += v;
+    REQUIRE(sum / m == Catch::Approx(0.5).margin(0.005));
+    rng.normal(0, m, 2, values.data());
+    double mean = 0.0, square = 0.0, tail = 0.0;
+    for (float v : values) {
+        mean += v;
+        square += double(v) * v;
+        if (std::fabs(v) > 1.959964f) tail++;
+    }
+    REQUIRE(mean / m == Catch::Approx(0.0).margin(0.01));
+    REQUIRE(square / m == Catch::Approx(1.0).margin(0.01));
+    REQUIRE(tail / m == Catch::Approx(0.05).margin(0.003));
+}
+
+TEST_CASE("FlightPath endpoints depend only on the seed", "[FlightPath]")
+{
+    const FlightPath a(0, 100, 5000, 9000, 2500.0f, 42), b(0, 100, 5000, 9000, 2500.0f, 42), c(0, 100, 5000, 9000, 2500.0f, 43);
+    const std::vector<Point> first = a.GenerateFlightPath(), again = a.GenerateFlightPath(), twin = b.GenerateFlightPath(), other = c.GenerateFlightPath();
+    REQUIRE(first.size() == 2);
+    for (size_t i = 0; i < 2; i++) {
+        REQUIRE(first[i].x_ == again[i].x_);
+        REQUIRE(first[i].y_ == twin[i].y_);
+        REQUIRE(first[i].x_ >= 0.0f);
+        REQUIRE(first[i].x_ <= 5000.0f);
+        REQUIRE(first[i].y_ >= 100.0f);
+        REQUIRE(first[i].y_ <= 9000.0f);
+        REQUIRE(first[i].z_ == 2500.0f);
+    }
+    REQUIRE(first[0].x_ != other[0].x_);
+}
+
+TEST_CASE("Pulse noise is the same for any thread count", "[PulseSimulator][PhiloxRng]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const PolygonPattern pattern(0.8f, 200);
+    const FlightLine line{ Point(1000.0f, 4500.0f, 2500.0f), Point(8000.0f, 4500.0f, 2500.0f), 60.0f };
+
+    PulseSimulator clean(sensor, 2000.0, 1000), noisy(sensor, 2000.0, 1000);
+    noisy.setNoise({ 0.05f, 0.1f, 99 });
+    const std::vector<PulseReturn> reference = clean.simulate(pattern, line);
+    const std::vector<PulseReturn> serial = noisy.simulate(pattern, line);
+    ThreadPool pool(3);
+    const std::vector<PulseReturn> parallel = noisy.simulate(pattern, line, &pool);
+    REQUIRE(parallel.size() == serial.size());
+    REQUIRE(std::memcmp(parallel.data(), serial.data(), serial.size() * sizeof(PulseReturn)) == 0);
+
+    // About a tenth of the hits dropped; the rest moved along their rays by
+    // errors of the requested spread.
+    const double kept = static_cast<double>(serial.size()) / reference.size();
+    REQUIRE(kept == Catch::Approx(0.9).margin(0.01));
+    double square = 0.0;
+    size_t j = 0;
+    for (const PulseReturn& p : serial) {
+        while (reference[j].pulse != p.pulse) j++;
+        const double e = p.range - reference[j].range;
+        square += e * e;
+    }
+    REQUIRE(std::sqrt(square / serial.size()) == Catch::Approx(0.05).margin(0.003));
+    REQUIRE_THROWS_AS(noisy.setNoise({ 0.0f, 1.5f, 0 }), std::invalid_argument);
+}
+
+TEST_CASE("Beam footprints split into returns and refine only at edges", "[LidarSensor]")
+{
+    // A flat plain at 100 m with a 100 m high plateau east of column 150.
+    const size_t size = 301;
+    const float cell = 30.0f;
+    std::vector<float> elevations(size * size);
+    for (size_t r = 0; r < size; r++) {
+        for (size_t c = 0; c < size; c++) elevations[r * size + c] = c > 150 ? 200.0f : 100.0f;
+    }
+    const LidarSensor sensor(GridView<float>::square(elevations), cell, cell);
+    BeamModel beam;
+    beam.divergence = 0.1f;
+
+    // Flat ground: the first samples agree, one return from the whole footprint.
+    const BeamReturns flat = sensor.castBeam({ 1500.0f, 4500.0f, 1100.0f, 0.0f, 0.0f, -1.0f }, beam);
+    REQUIRE(flat.samples == beam.minSamples);
+    REQUIRE(flat.count == 1);
+    REQUIRE(flat.weight[0] == 1.0f);
+    REQUIRE(flat.returns[0].range == Catch::Approx(1000.0f).margin(2.0));
+    REQUIRE(flat.returns[0].z == Catch::Approx(100.0f).margin(1e-3));
+
+    // Straddling the escarpment: refined to the full budget, first return
+    // from the plateau top, last from the plain.
+    const BeamReturns edge = sensor.castBeam({ 150.5f * cell, 4500.0f, 1100.0f, 0.0f, 0.0f, -1.0f }, beam);
+    REQUIRE(edge.samples == beam.maxSamples);
+    REQUIRE(edge.count >= 2);
+    REQUIRE(edge.count <= kMaxBeamReturns);
+    REQUIRE(edge.returns[0].range < edge.returns[edge.count - 1].range);
+    REQUIRE(edge.returns[0].range == Catch::Approx(900.0f).margin(5.0));
+    REQUIRE(edge.returns[edge.count - 1].range == Catch::Approx(1000.0f).margin(5.0));
+    float total = 0.0f;
+    for (size_t i = 0; i < edge.count; i++) total += edge.weight[i];
+    REQUIRE(total == Catch::Approx(1.0f));
+
+    // A beam half off the grid also refines; one pointing away returns nothing.
+    REQUIRE(sensor.castBeam({ 0.0f, 4500.0f, 1100.0f, 0.0f, 0.0f, -1.0f }, beam).samples == beam.maxSamples);
+    REQUIRE(sensor.castBeam({ 4500.0f, 4500.0f, 1100.0f, 0.0f, 0.0f, 1.0f }, beam).count == 0);
+    beam.maxSamples = kMaxBeamSamples + 1;
+    REQUIRE_THROWS_AS(sensor.castBeam({ 4500.0f, 4500.0f, 1100.0f, 0.0f, 0.0f, -1.0f }, beam), std::invalid_argument);
+}
+
+// Discards everything written to it.
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// Discards everything written to it, slowly.
+class SlowBuffer : public NullBuffer
+{
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        return NullBuffer::xsputn(s, n);
+    }
+};
+
+TEST_CASE("The streaming pipeline writes what the simulator returns", "[PulsePipeline]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const ZigZagPattern pattern(0.8f, 150);
+    const FlightLine line{ Point(1000.0f, 1200.0f, 2500.0f), Point(8000.0f, 7500.0f, 2500.0f), 60.0f, 5000.0 };
+    PulseSimulator simulator(sensor, 3000.0, 1024);
+    simulator.setNoise({ 0.05f, 0.02f, 7 });
+
+    std::ostringstream expected;
+    PointCloudWriter reference(expected);
+    const std::vector<PulseReturn> simulated = simulator.simulate(pattern, line);
+    reference.write(simulated.data(), simulated.size());
+    REQUIRE(reference.pointCount() == simulated.size());
+
+    // Three batches in flight, casting on a pool as well.
+    const PulsePipeline pipeline(simulator, 1024, 3);
+    ThreadPool pool(2);
+    std::ostringstream streamed;
+    PointCloudWriter writer(streamed);
+    const PipelineStats stats = pipeline.run(pattern, line, writer, &pool);
+    REQUIRE(stats.pulses == simulator.pulseCount(line));
+    REQUIRE(stats.points == simulated.size());
+    REQUIRE(streamed.str() == expected.str());
+
+    // The lines carry time, position and range.
+    std::istringstream first(expected.str());
+    double time, x, y, z, range;
+    first >> time >> x >> y >> z >> range;
+    REQUIRE(time == Catch::Approx(simulated[0].time).margin(1e-6));
+    REQUIRE(z == Catch::Approx(simulated[0].z).margin(1e-3));
+
+    // Memory does not grow with the flight.
+    const FlightLine shortLine{ Point(1000.0f, 1200.0f, 2500.0f), Point(2000.0f, 1200.0f, 2500.0f), 60.0f };
+    NullBuffer discard;
+    std::ostream sink(&discard);
+    PointCloudWriter nullWriter(sink);
+    REQUIRE(pipeline.run(pattern, shortLine, nullWriter).bufferBytes == stats.bufferBytes);
+    REQUIRE(stats.bufferBytes < 3 * 1024 * 128);
+
+    // A slow writer holds the trajectory stage back in the same memory.
+    SlowBuffer slow;
+    std::ostream slowSink(&slow);
+    PointCloudWriter slowWriter(slowSink);
+    const PipelineStats slowStats = pipeline.run(pattern, shortLine, slowWriter);
+    REQUIRE(slowStats.pulses == simulator.pulseCount(shortLine));
+    REQUIRE(slowStats.stalls > 0);
+    REQUIRE(slowStats.bufferBytes == stats.bufferBytes);
+
+    // A failing writer stops the stages and its error comes back.
+    std::ostream broken(nullptr);
+    PointCloudWriter failing(broken);
+    REQUIRE_THROWS_AS(pipeline.run(pattern, line, failing), std::runtime_error);
+    REQUIRE_THROWS_AS(PulsePipeline(simulator, 1001, 3), std::invalid_argument);
+}
+
+TEST_CASE("Trajectory interpolates positions and attitudes at pulse times", "[Trajectory]")
+{
+    // A 200 Hz trajectory turning at a constant rate about the vertical
+    // while climbing: slerp and lerp reproduce it exactly between samples.
+    const double rate = 200.0, omega = 0.3, t0 = 1000.0;
+    std::vector<TrajectorySample> samples(401);
+    for (size_t k = 0; k < samples.size(); k++) {
+        const double t = k / rate, yaw = omega * t;
+        // Stored with alternating signs: q and -q are the same attitude.
+        const float sign = k % 2 ? -1.0f : 1.0f;
+        samples[k] = { t0 + t, static_cast<float>(50.0 * t), 100.0f, static_cast<float>(2000.0 + 5.0 * t),
+            { sign * static_cast<float>(std::cos(0.5 * yaw)), 0.0f, 0.0f, sign * static_cast<float>(std::sin(0.5 * yaw)) } };
+    }
+    Trajectory trajectory(samples);
+    // Sensor 1 m ahead of the IMU, turned 90 degrees to the left.
+    trajectory.setMounting({ std::cos(0.25f * 3.14159265f), 0.0f, 0.0f, std::sin(0.25f * 3.14159265f) }, 1.0f, 0.0f, 0.0f);
+
+    const size_t n = 20011;
+    std::vector<double> times(n);
+    for (size_t i = 0; i < n; i++) times[i] = t0 - 0.01 + 2.02 * static_cast<double>(i) / n;
+    PoseBatch poses, scalar, pieces;
+    Trajectory::Cursor cursor, scalarCursor, piecesCursor;
+    trajectory.interpolate(times.data(), n, cursor, poses);
+    trajectory.interpolateScalar(times.data(), n, scalarCursor, scalar);
+    // Fed in uneven pieces, the cursor carries on where the last piece ended.
+    PoseBatch piece;
+    pieces.resize(n);
+    for (size_t begin = 0; begin < n; begin += 997) {
+        const size_t m = std::min<size_t>(997, n - begin);
+        trajectory.interpolate(times.data() + begin, m, piecesCursor, piece);
+        for (size_t j = 0; j < m; j++) pieces.tx[begin + j] = piece.tx[j];
+    }
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < n; i++) {
+        const double t = std::min(std::max(times[i] - t0, 0.0), 2.0), yaw = omega * t;
+        const double heading = yaw + 0.5 * 3.14159265358979;
+        const double expected[9] = { std::cos(heading), -std::sin(heading), 0.0, std::sin(heading), std::cos(heading), 0.0, 0.0, 0.0, 1.0 };
+        for (int e = 0; e < 9; e++) {
+            if (std::fabs(poses.r[e][i] - expected[e]) > 2e-6 || std::fabs(scalar.r[e][i] - poses.r[e][i]) > 1e-6f) wrong++;
+        }
+        const double ex = 50.0 * t + std::cos(yaw), ey = 100.0 + std::sin(yaw), ez = 2000.0 + 5.0 * t;
+        if (std::fabs(poses.tx[i] - ex) > 2e-3 || std::fabs(poses.ty[i] - ey) > 2e-3 || std::fabs(poses.tz[i] - ez) > 2e-3) wrong++;
+        if (std::fabs(scalar.tx[i] - poses.tx[i]) > 1e-4f || pieces.tx[i] != poses.tx[i]) wrong++;
+    }
+    REQUIRE(wrong == 0);
+    REQUIRE(cursor.segment == samples.size() - 2);
+
+    // A time before the cursor is found again by search.
+    const double back = t0 + 0.5;
+    trajectory.interpolate(&back, 1, cursor, piece);
+    REQUIRE(piece.tx[0] == Catch::Approx(25.0 + std::cos(0.15)).margin(2e-3));
+
+    REQUIRE_THROWS_AS(Trajectory(std::vector<TrajectorySample>(1)), std::invalid_argument);
+    std::vector<TrajectorySample> unordered = { samples[1], samples[0] };
+    REQUIRE_THROWS_AS(Trajectory(unordered), std::invalid_argument);
+}
+
+TEST_CASE("Scanning from trajectory poses matches a straight platform", "[Trajectory][LidarSensor]")
+{
+    const size_t size = 301;
+    const float cell = 30.0f;
+    const HillSensor hill = makeHillSensor(size, cell);
+    const LidarSensor& sensor = hill.sensor;
+    const PalmerPattern pattern(0.26f, 0.26f, 500);
+    const FlightLine line{ Point(1000.0f, 1500.0f, 2500.0f), Point(8000.0f, 6500.0f, 2500.0f), 60.0f, 300.0 };
+    const Trajectory trajectory = Trajectory::fromFlightLine(line);
+    REQUIRE(trajectory.startTime() == 300.0);
+
+    // 5000 pulses at 10 kHz from the trajectory and from the equivalent platform.
+    const double pulseRate = 10000.0;
+    const size_t count = 5003;
+    std::vector<double> times(count);
+    for (size_t i = 0; i < count; i++) times[i] = line.startTime + static_cast<double>(i) / pulseRate;
+    PoseBatch poses;
+    Trajectory::Cursor cursor;
+    trajectory.interpolate(times.data(), count, cursor, poses);
+    std::vector<LidarReturn> fromPoses(count), fromPlatform(count);
+    sensor.scan(pattern, poses, 0, fromPoses.data());
+    sensor.scan(pattern, flightPlatform(line, pulseRate, 0), 0, count, fromPlatform.data());
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (fromPoses[i].hit != fromPlatform[i].hit || std::fabs(fromPoses[i].range - fromPlatform[i].range) > 0.05f) wrong++;
+    }
+    REQUIRE(wrong == 0);
+}
+
+TEST_CASE("Pulse poses: binary search vs cursor vs AVX2 slerp", "[.][benchmark][Trajectory]")
+{
+    // 500 kHz pulses over a 200 Hz trajectory of a gently banking turn.
+    std::vector<TrajectorySample> samples(2001);
+    for (size_t k = 0; k < samples.size(); k++) {
+        const double t = k / 200.0, yaw = 0.05 * t, roll = 0.1 * std::sin(t);
+        const double cy = std::cos(0.5 * yaw), sy = std::sin(0.5 * yaw), cr = std::cos(0.5 * roll), sr = std::sin(0.5 * roll);
+        samples[k] = { t, static_cast<float>(60.0 * t), 0.0f, 2000.0f,
+            { static_cast<float>(cy * cr), static_cast<float>(cy * sr), static_cast<float>(sy * sr), static_cast<float>(sy * cr) } };
+    }
+    const Trajectory trajectory(samples);
+    std::vector<double> sampleTimes(samples.size());
+    for (size_t k = 0; k < samples.size(); k++) sampleTimes[k] = samples[k].time;
+    const size_t n = 1 << 20;
+    std::vector<double> times(n);
+    for (size_t i = 0; i < n; i++) times[i] = static_cast<double>(i) / 500000.0;
+    PoseBatch poses;
+
+    BENCHMARK("binary search per pulse, scalar") {
+        // upper_bound finds each pulse's segment, so the cursor never walks.
+        PoseBatch one;
+        for (size_t i = 0; i < n; i++) {
+            Trajectory::Cursor found;
+            const size_t after = static_cast<size_t>(std::upper_bound(sampleTimes.begin(), sampleTimes.end() - 1, times[i]) - sampleTimes.begin());
+            found.segment = std::min(after > 0 ? after - 1 : 0, sampleTimes.size() - 2);
+            trajectory.interpolateScalar(&times[i], 1, found, one);
+        }
+        return one.tx[0];
+    };
+    BENCHMARK("cursor, scalar") {
+        Trajectory::Cursor cursor;
+        trajectory.interpolateScalar(times.data(), n, cursor, poses);
+        return poses.tx[n / 2];
+    };
+    BENCHMARK("cursor, AVX2") {
+        Trajectory::Cursor cursor;
+        trajectory.interpolate(times.data(), n, cursor, poses);
+        return poses.tx[n / 2];
+    };
+}
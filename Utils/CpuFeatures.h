@@ -0,0 +1,93 @@
+#pragma once
+
+// Runtime CPU feature detection for the SIMD kernels.
+// Kernels are compiled for their instruction set with SIM_TARGET_* and only
+// called after the matching cpuHas*() check, so the binary still runs on
+// machines without AVX2.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define SIM_X86 0
+#endif
+
+#if SIM_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIM_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+// AVX2 without FMA, for kernels that must round exactly like their scalar
+// reference: with FMA enabled GCC and Clang fuse multiply-add intrinsics.
+#define SIM_TARGET_AVX2_NOFMA __attribute__((target("avx2")))
+#else
+#define SIM_TARGET_SSE41
+#define SIM_TARGET_AVX2
+#define SIM_TARGET_AVX2_NOFMA
+#endif
+
+#if SIM_X86
+namespace cpu_detail {
+    inline void cpuid(int out[4], int leaf, int subleaf)
+    {
+#ifdef _MSC_VER
+        __cpuidex(out, leaf, subleaf);
+#else
+        unsigned a, b, c, d;
+        __asm__ __volatile__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(subleaf));
+        out[0] = static_cast<int>(a); out[1] = static_cast<int>(b);
+        out[2] = static_cast<int>(c); out[3] = static_cast<int>(d);
+#endif
+    }
+
+    inline unsigned long long xgetbv0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        unsigned lo, hi;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    }
+
+    struct Features {
+        bool sse41 = false;
+        bool avx2 = false;
+
+        Features()
+        {
+            int r[4];
+            cpuid(r, 0, 0);
+            const int maxLeaf = r[0];
+            if (maxLeaf < 1) return;
+
+            cpuid(r, 1, 0);
+            sse41 = (r[2] & (1 << 19)) != 0;
+            const bool osxsave = (r[2] & (1 << 27)) != 0;
+            const bool avx = (r[2] & (1 << 28)) != 0;
+            const bool fma = (r[2] & (1 << 12)) != 0;
+            // The OS must save the YMM state for AVX to be usable.
+            const bool ymmEnabled = osxsave && (xgetbv0() & 0x6) == 0x6;
+
+            if (maxLeaf >= 7 && avx && fma && ymmEnabled) {
+                cpuid(r, 7, 0);
+                avx2 = (r[1] & (1 << 5)) != 0;
+            }
+        }
+    };
+
+    inline const Features& features()
+    {
+        static const Features f;
+        return f;
+    }
+}
+
+inline bool cpuHasSse41() { return cpu_detail::features().sse41; }
+inline bool cpuHasAvx2() { return cpu_detail::features().avx2; }
+#else
+inline bool cpuHasSse41() { return false; }
+inline bool cpuHasAvx2() { return false; }
+#endif
@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "PhiloxRng.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <cstring>
+
+static constexpr uint32_t kPhiloxM0 = 0xD2511F53u, kPhiloxM1 = 0xCD9E8D57u;
+static constexpr uint32_t kPhiloxW0 = 0x9E3779B9u, kPhiloxW1 = 0xBB67AE85u;
+static constexpr float kTwoPow24 = 1.0f / 16777216.0f;
+
+PhiloxRng::Block PhiloxRng::block(uint64_t index, uint32_t stream) const
+{
+    uint32_t c0 = static_cast<uint32_t>(index), c1 = static_cast<uint32_t>(index >> 32), c2 = stream, c3 = 0;
+    uint32_t k0 = key_[0], k1 = key_[1];
+    for (int round = 0; round < 10; round++) {
+        const uint64_t p0 = uint64_t(kPhiloxM0) * c0, p1 = uint64_t(kPhiloxM1) * c2;
+        const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+        c1 = static_cast<uint32_t>(p1);
+        c3 = static_cast<uint32_t>(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+    return { c0, c1, c2, c3 };
+}
+
+// Box-Muller needs log and sincos; these are written out as plain multiplies
+// and adds (no fused operations) so the scalar and AVX2 code round alike and
+// give the same bits. Polynomials after Cephes logf/sinf/cosf.
+static float logPositive(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int e = static_cast<int>(bits >> 23) - 126;
+    bits = (bits & 0x007FFFFFu) | 0x3F000000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m)); // [0.5, 1)
+    if (m < 0.707106781f) {
+        e -= 1;
+        m = m + m - 1.0f;
+    } else {
+        m = m - 1.0f;
+    }
+    const float z = m * m;
+    float y = 7.0376836292e-2f;
+    y = y * m + -1.1514610310e-1f;
+    y = y * m + 1.1676998740e-1f;
+    y = y * m + -1.2420140846e-1f;
+    y = y * m + 1.4249322787e-1f;
+    y = y * m + -1.6668057665e-1f;
+    y = y * m + 2.0000714765e-1f;
+    y = y * m + -2.4999993993e-1f;
+    y = y * m + 3.3333331174e-1f;
+    y = y * m * z;
+    const float fe = static_cast<float>(e);
+    y = y + fe * -2.12194440e-4f;
+    y = y + -0.5f * z;
+    return m + y + fe * 0.693359375f;
+}
+
+// A standard normal from two uniform words. The angle is drawn as a quarter
+// turn q plus an offset in [-pi/4, pi/4), which keeps the polynomials in
+// their accurate range; it is still uniform on the circle.
+static float boxMuller(uint32_t a, uint32_t b)
+{
+    const float u = static_cast<float>((a >> 8) + 1) * kTwoPow24; // (0, 1]
+    const float r = std::sqrt(-2.0f * logPositive(u));
+    const uint32_t q = b >> 30;
+    const float x = (static_cast<float>((b >> 6) & 0xFFFFFFu) * kTwoPow24 - 0.5f) * 1.57079632679f;
+    const float x2 = x * x;
+    float s = -1.9515295891e-4f;
+    s = s * x2 + 8.3321608736e-3f;
+    s = s * x2 + -1.6666654611e-1f;
+    s = s * x2 * x + x;
+    float c = 2.443315711809948e-5f;
+    c = c * x2 + -1.388731625493765e-3f;
+    c = c * x2 + 4.166664568298827e-2f;
+    c = c * x2 * x2 + (1.0f - 0.5f * x2);
+    // cos(q * pi/2 + x)
+    const float cosine = q == 0 ? c : q == 1 ? -s : q == 2 ? -c : s;
+    return r * cosine;
+}
+
+float PhiloxRng::uniform(uint64_t index, uint32_t stream) const
+{
+    return static_cast<float>(block(index, stream)[0] >> 8) * kTwoPow24;
+}
+
+float PhiloxRng::normal(uint64_t index, uint32_t stream) const
+{
+    const Block b = block(index, stream);
+    return boxMuller(b[0], b[1]);
+}
+
+void PhiloxRng::uniformScalar(uint64_t first, size_t n, uint32_t stream, float* out) const
+{
+    for (size_t i = 0; i < n; i++) out[i] = uniform(first + i, stream);
+}
+
+void PhiloxRng::normalScalar(uint64_t first, size_t n, uint32_t stream, float* out) const
+{
+    for (size_t i = 0; i < n; i++) out[i] = normal(first + i, stream);
+}
+
+#if SIM_X86
+// High and low halves of m * x per 32-bit lane.
+SIM_TARGET_AVX2_NOFMA static void mulHiLo(__m256i m, __m256i x, __m256i& hi, __m256i& lo)
+{
+    const __m256i even = _mm256_mul_epu32(x, m);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+// First two words of the blocks of indices first .. first+7.
+SIM_TARGET_AVX2_NOFMA static void philoxAvx2(const uint32_t key[2], uint64_t first, uint32_t stream, __m256i& w0, __m256i& w1)
+{
+    alignas(32) uint32_t lo[8], hi[8];
+    for (int i = 0; i < 8; i++) {
+        lo[i] = static_cast<uint32_t>(first + i);
+        hi[i] = static_cast<uint32_t>((first + i) >> 32);
+    }
+    __m256i c0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lo));
+    __m256i c1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(hi));
+    __m256i c2 = _mm256_set1_epi32(static_cast<int>(stream)), c3 = _mm256_setzero_si256();
+    const __m256i m0 = _mm256_set1_epi32(static_cast<int>(kPhiloxM0)), m1 = _mm256_set1_epi32(static_cast<int>(kPhiloxM1));
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        __m256i hi0, lo0, hi1, lo1;
+        mulHiLo(m0, c0, hi0, lo0);
+        mulHiLo(m1, c2, hi1, lo1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+        c1 = lo1;
+        c3 = lo0;
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+    w0 = c0;
+    w1 = c1;
+}
+
+SIM_TARGET_AVX2_NOFMA static __m256 toUnit(__m256i bits, int offset)
+{
+    const __m256i v = _mm256_add_epi32(_mm256_srli_epi32(bits, 8), _mm256_set1_epi32(offset));
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(kTwoPow24));
+}
+
+SIM_TARGET_AVX2_NOFMA static __m256 logPositiveAvx2(__m256 x)
+{
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000)));
+    const __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781f), _CMP_LT_OQ);
+    e = _mm256_add_epi32(e, _mm256_castps_si256(small)); // -1 where small
+    m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), _mm256_set1_ps(1.0f));
+    const __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.1676998740e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(1.4249322787e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(2.0000714765e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    const __m256 fe = _mm256_cvtepi32_ps(e);
+    y = _mm256_add_ps(y, _mm256_mul_ps(fe, _mm256_set1_ps(-2.12194440e-4f)));
+    y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(-0.5f), z));
+    return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(fe, _mm256_set1_ps(0.693359375f)));
+}
+
+SIM_TARGET_AVX2_NOFMA static __m256 boxMullerAvx2(__m256i a, __m256i b)
+{
+    const __m256 u = toUnit(a, 1);
+    const __m256 r = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), logPositiveAvx2(u)));
+    const __m256i q = _mm256_srli_epi32(b, 30);
+    const __m256i frac = _mm256_and_si256(_mm256_srli_epi32(b, 6), _mm256_set1_epi32(0xFFFFFF));
+    const __m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(frac), _mm256_set1_ps(kTwoPow24)), _mm256_set1_ps(0.5f)),
+        _mm256_set1_ps(1.57079632679f));
+    const __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 s = _mm256_set1_ps(-1.9515295891e-4f);
+    s = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(8.3321608736e-3f));
+    s = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(-1.6666654611e-1f));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, x2), x), x);
+    __m256 c = _mm256_set1_ps(2.443315711809948e-5f);
+    c = _mm256_add_ps(_mm256_mul_ps(c, x2), _mm256_set1_ps(-1.388731625493765e-3f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, x2), _mm256_set1_ps(4.166664568298827e-2f));
+    c = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c, x2), x2), _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), x2)));
+    // Odd quarters use sine, quarters 1 and 2 are negated.
+    const __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    const __m256i flip = _mm256_cmpeq_epi32(_mm256_srli_epi32(_mm256_add_epi32(q, _mm256_set1_epi32(1)), 1), _mm256_set1_epi32(1));
+    __m256 cosine = _mm256_blendv_ps(c, s, odd);
+    cosine = _mm256_xor_ps(cosine, _mm256_and_ps(_mm256_castsi256_ps(flip), _mm256_set1_ps(-0.0f)));
+    return _mm256_mul_ps(r, cosine);
+}
+
+SIM_TARGET_AVX2_NOFMA static void uniformAvx2(const uint32_t key[2], uint64_t first, size_t n, uint32_t stream, float* out)
+{
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i w0, w1;
+        philoxAvx2(key, first + i, stream, w0, w1);
+        _mm256_storeu_ps(out + i, toUnit(w0, 0));
+    }
+}
+
+SIM_TARGET_AVX2_NOFMA static void normalAvx2(const uint32_t key[2], uint64_t first, size_t n, uint32_t stream, float* out)
+{
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i w0, w1;
+        philoxAvx2(key, first + i, stream, w0, w1);
+        _mm256_storeu_ps(out + i, boxMullerAvx2(w0, w1));
+    }
+}
+#endif
+
+void PhiloxRng::uniform(uint64_t first, size_t n, uint32_t stream, float* out) const
+{
+    size_t done = 0;
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        done = n & ~size_t(7);
+        uniformAvx2(key_, first, done, stream, out);
+    }
+#endif
+    uniformScalar(first + done, n - done, stream, out + done);
+}
+
+void PhiloxRng::normal(uint64_t first, size_t n, uint32_t stream, float* out) const
+{
+    size_t done = 0;
+#if SIM_X86
+    if (cpuHasAvx2()) {
+        done = n & ~size_t(7);
+        normalAvx2(key_, first, done, stream, out);
+    }
+#endif
+    normalScalar(first + done, n - done, stream, out + done);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3", SC'11). Every value is a pure
+// function of (seed, index, stream): 'index' is typically a pulse number and
+// 'stream' separates independent uses (range noise, dropouts, ...), so
+// results do not depend on which thread asks, in which order, or how work is
+// batched. There is no state to share or lock.
+//
+// The batch calls produce the values of consecutive indices, 8 blocks at a
+// time with AVX2 when available; they are bit-identical to the single-value
+// calls on every path.
+class PhiloxRng
+{
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    explicit PhiloxRng(uint64_t seed) : key_{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) } {}
+
+    // The raw 128 random bits for (index, stream).
+    Block block(uint64_t index, uint32_t stream) const;
+
+    // Uniform in [0, 1), from the first word of the block; 24 bits.
+    float uniform(uint64_t index, uint32_t stream) const;
+
+    // Standard normal, by Box-Muller from the first two words of the block.
+    float normal(uint64_t index, uint32_t stream) const;
+
+    // Values for indices first .. first+n-1.
+    void uniform(uint64_t first, size_t n, uint32_t stream, float* out) const;
+    void normal(uint64_t first, size_t n, uint32_t stream, float* out) const;
+
+    // Same, always scalar.
+    void uniformScalar(uint64_t first, size_t n, uint32_t stream, float* out) const;
+    void normalScalar(uint64_t first, size_t n, uint32_t stream, float* out) const;
+
+private:
+    uint32_t key_[2];
+};
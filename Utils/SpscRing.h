@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. push() blocks while the ring is full and pop() while it
+// is empty. A ring with room for every item in circulation never fills: a
+// slow consumer then holds back its producer by not handing items back, and
+// the producer waits in pop() on the return ring. Waiting spins briefly and
+// then yields, so stages sharing a core still make progress.
+//
+// close() is called by the producer after its last push: pop() then drains
+// what is left and returns false. cancel() may be called from any thread to
+// tear a pipeline down: blocked and later push()/pop() calls return false.
+template <typename T>
+class SpscRing
+{
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity)
+    {
+        if (capacity == 0) throw std::invalid_argument("ring capacity must be positive");
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return slots_.size(); }
+
+    bool tryPush(const T& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size()) return false;
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(const T& value)
+    {
+        if (tryPush(value)) return true;
+        for (unsigned spins = 0; !cancelled_.load(std::memory_order_relaxed); spins++) {
+            if (tryPush(value)) return true;
+            if (spins >= 64) std::this_thread::yield();
+        }
+        return false;
+    }
+
+    bool pop(T& value)
+    {
+        for (unsigned spins = 0; !cancelled_.load(std::memory_order_relaxed); spins++) {
+            if (tryPop(value)) return true;
+            // Closed: one more look, since the last push may have raced the check.
+            if (closed_.load(std::memory_order_acquire)) return tryPop(value);
+            if (spins == 0) emptyWaits_.fetch_add(1, std::memory_order_relaxed);
+            if (spins >= 64) std::this_thread::yield();
+        }
+        return false;
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    // Number of pop() calls that found the open ring empty and had to wait.
+    size_t emptyWaits() const { return emptyWaits_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    // Producer and consumer indices on separate cache lines.
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    alignas(64) std::atomic<bool> closed_{ false };
+    std::atomic<bool> cancelled_{ false };
+    std::atomic<size_t> emptyWaits_{ 0 };
+};
@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads fed from one shared FIFO queue.
+// submit() returns a future for the task's result; exceptions thrown by the
+// task are delivered through the future. The destructor finishes all queued
+// tasks before joining the workers.
+class ThreadPool
+{
+public:
+    // 0 threads means one per hardware thread.
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task)
+    {
+        using Result = std::invoke_result_t<F>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        enqueue([packaged] { (*packaged)(); });
+        return result;
+    }
+
+    // Split [0, count) into contiguous ranges and call fn(begin, end) for each,
+    // on the workers and the calling thread, returning when all are done.
+    // Must not be called from inside a pool task.
+    template <typename F>
+    void parallelFor(size_t count, F&& fn)
+    {
+        const size_t chunks = std::min(count, 4 * size());
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunks);
+        for (size_t c = 1; c < chunks; c++) {
+            pending.push_back(submit([&fn, c, chunks, count] { fn(count * c / chunks, count * (c + 1) / chunks); }));
+        }
+        // Wait for every chunk before rethrowing; they all reference 'fn'.
+        std::exception_ptr error;
+        try {
+            if (chunks > 0) fn(size_t(0), count / chunks);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& p : pending) {
+            try {
+                p.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Call fn(i, worker) for every i in [0, count), on the workers and the
+    // calling thread; 'worker' in [0, size()] names the participant, so fn
+    // can keep per-participant buffers. Each participant starts on its own
+    // contiguous run of items, in order, and once it runs dry steals the
+    // back half of another's run, so uneven items still balance out.
+    // Throws std::invalid_argument if count does not fit in 32 bits. Must not
+    // be called from inside a pool task.
+    template <typename F>
+    void stealingFor(size_t count, F&& fn)
+    {
+        if (count > 0xffffffffu) throw std::invalid_argument("stealingFor count must fit in 32 bits");
+        const size_t participants = std::min(count, size() + 1);
+        if (participants == 0) return;
+        // Remaining run of each participant as begin << 32 | end; the owner
+        // advances begin, thieves pull end back.
+        std::vector<std::atomic<uint64_t>> runs(participants);
+        for (size_t p = 0; p < participants; p++) {
+            runs[p].store(uint64_t(count * p / participants) << 32 | uint64_t(count * (p + 1) / participants));
+        }
+        auto work = [&fn, &runs, participants](size_t self) {
+            for (;;) {
+                uint64_t run = runs[self].load();
+                while ((run >> 32) < (run & 0xffffffffu)) {
+                    if (runs[self].compare_exchange_weak(run, run + (uint64_t(1) << 32))) {
+                        fn(static_cast<size_t>(run >> 32), self);
+                        run = runs[self].load();
+                    }
+                }
+                bool stole = false;
+                for (size_t k = 1; k < participants && !stole; k++) {
+                    std::atomic<uint64_t>& victim = runs[(self + k) % participants];
+                    uint64_t theirs = victim.load();
+                    while (!stole && (theirs >> 32) < (theirs & 0xffffffffu)) {
+                        const uint64_t end = theirs & 0xffffffffu, take = (end - (theirs >> 32) + 1) / 2;
+                        if (victim.compare_exchange_weak(theirs, theirs - take)) {
+                            runs[self].store((end - take) << 32 | end);
+                            stole = true;
+                        }
+                    }
+                }
+                if (!stole) return;
+            }
+        };
+
+        std::vector<std::future<void>> pending;
+        pending.reserve(participants - 1);
+        for (size_t p = 1; p < participants; p++) {
+            pending.push_back(submit([&work, p] { work(p); }));
+        }
+        // As in parallelFor, wait for every participant before rethrowing.
+        std::exception_ptr error;
+        try {
+            work(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& p : pending) {
+            try {
+                p.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void enqueue(std::function<void()> task);
+    void run();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+
+// Run fn(begin, end) over [0, count), split into bands on 'pool' if given,
+// or in one call on this thread otherwise.
+template <typename F>
+void forBands(ThreadPool* pool, size_t count, F&& fn)
+{
+    if (pool && pool->size() > 1 && count > 1) {
+        pool->parallelFor(count, fn);
+    } else {
+        fn(size_t(0), count);
+    }
+}
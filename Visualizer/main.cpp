@@ -6,11 +6,10 @@
 int main()
 {
 	const std::string filepath = "C:\\Dev\\LidarSimulator\\SRTM\\N33W118.hgt";
-	const int size = 3601;
 	const int step = 5;
-	SrtmReader dem(filepath, size);
+	SrtmReader dem(filepath);
 	std::vector<float> vertices = dem.getElevationData();
 
-	SrtmView view(filepath, size);
+	SrtmView view(filepath, static_cast<int>(dem.size()));
 	return view.showSrtmData(vertices);
 }
\ No newline at end of file